@@ -0,0 +1,62 @@
+/*
+assets.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "assets.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+std::mutex assets_mutex;
+
+template <typename Resource>
+const Resource& load_shared(std::map<std::string, std::unique_ptr<Resource>>& cache, const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(assets_mutex);
+
+    auto& entry = cache[path];
+    if (!entry)
+    {
+        entry.reset(new Resource);
+        entry->loadFromFile(path); // SFML already reports failures, an empty resource is still usable
+    }
+
+    return *entry;
+}
+}
+
+const sf::Texture &shared_texture(const std::string &path)
+{
+    static std::map<std::string, std::unique_ptr<sf::Texture>> textures;
+    return load_shared(textures, path);
+}
+
+const sf::Font &shared_font(const std::string &path)
+{
+    static std::map<std::string, std::unique_ptr<sf::Font>> fonts;
+    return load_shared(fonts, path);
+}
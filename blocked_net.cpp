@@ -0,0 +1,191 @@
+/*
+blocked_net.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "blocked_net.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+// multiply-adds of a layer pass below which one thread does it all
+const size_t parallel_work = 1 << 16;
+
+// The tile loops want their sums side by side in SIMD registers (across rows),
+// which GCC's loop vectorizer defeats by vectorizing over the inputs instead.
+#if defined(__GNUC__) && !defined(__clang__)
+#define row_vectorized __attribute__((optimize("no-tree-loop-vectorize")))
+#else
+#define row_vectorized
+#endif
+
+// Adds inputs [k0; k1) of a sample into the sums of one tile, which start
+// from its biases on the first block and from out on the others. The sums
+// are named rather than indexed so that they stay in registers.
+row_vectorized void tile_block(const double* tile, int k0, int k1, const double* in, double* out)
+{
+    static_assert(blocked_net::tile_rows == 8, "one sum per tile row");
+
+    const double* from = k0 == 0 ? tile : out;
+    const double  sign = k0 == 0 ? -1.0 : 1.0;
+    double s0 = from[0] * sign, s1 = from[1] * sign, s2 = from[2] * sign, s3 = from[3] * sign;
+    double s4 = from[4] * sign, s5 = from[5] * sign, s6 = from[6] * sign, s7 = from[7] * sign;
+
+    const double* w = tile + 8 * (1 + k0);
+    for (int k { k0 }; k < k1; ++k, w += 8)
+    {
+        const double x = in[k];
+        s0 += w[0] * x; s1 += w[1] * x; s2 += w[2] * x; s3 += w[3] * x;
+        s4 += w[4] * x; s5 += w[5] * x; s6 += w[6] * x; s7 += w[7] * x;
+    }
+
+    out[0] = s0; out[1] = s1; out[2] = s2; out[3] = s3;
+    out[4] = s4; out[5] = s5; out[6] = s6; out[7] = s7;
+}
+
+// The same for two samples, each weight load serving both.
+row_vectorized void tile_block_pair(const double* tile, int k0, int k1, const double* in, size_t in_stride, double* out, size_t out_stride)
+{
+    const double* from_a = k0 == 0 ? tile : out;
+    const double* from_b = k0 == 0 ? tile : out + out_stride;
+    const double  sign   = k0 == 0 ? -1.0 : 1.0;
+    double a0 = from_a[0] * sign, a1 = from_a[1] * sign, a2 = from_a[2] * sign, a3 = from_a[3] * sign;
+    double a4 = from_a[4] * sign, a5 = from_a[5] * sign, a6 = from_a[6] * sign, a7 = from_a[7] * sign;
+    double b0 = from_b[0] * sign, b1 = from_b[1] * sign, b2 = from_b[2] * sign, b3 = from_b[3] * sign;
+    double b4 = from_b[4] * sign, b5 = from_b[5] * sign, b6 = from_b[6] * sign, b7 = from_b[7] * sign;
+
+    const double* w = tile + 8 * (1 + k0);
+    for (int k { k0 }; k < k1; ++k, w += 8)
+    {
+        const double x = in[k], y = in[in_stride + k];
+        a0 += w[0] * x; a1 += w[1] * x; a2 += w[2] * x; a3 += w[3] * x;
+        a4 += w[4] * x; a5 += w[5] * x; a6 += w[6] * x; a7 += w[7] * x;
+        b0 += w[0] * y; b1 += w[1] * y; b2 += w[2] * y; b3 += w[3] * y;
+        b4 += w[4] * y; b5 += w[5] * y; b6 += w[6] * y; b7 += w[7] * y;
+    }
+
+    double* to = out;
+    to[0] = a0; to[1] = a1; to[2] = a2; to[3] = a3; to[4] = a4; to[5] = a5; to[6] = a6; to[7] = a7;
+    to = out + out_stride;
+    to[0] = b0; to[1] = b1; to[2] = b2; to[3] = b3; to[4] = b4; to[5] = b5; to[6] = b6; to[7] = b7;
+}
+
+}
+
+blocked_net::blocked_net(unsigned threads)
+{
+    if (threads > 1)
+        m_pool.reset(new shard_pool(threads));
+}
+
+void blocked_net::compile(const genann *ann)
+{
+    m_inputs       = ann->inputs;
+    m_output_count = ann->outputs;
+    m_layers.resize(ann->hidden_layers + 1);
+    m_values.resize(m_layers.size());
+
+    const double* w = ann->weight;
+    for (int h { 0 }; h <= ann->hidden_layers; ++h)
+    {
+        layer& l = m_layers[h];
+        l.output = h == ann->hidden_layers;
+        l.rows   = l.output ? ann->outputs : ann->hidden;
+        l.fan_in = h == 0 ? ann->inputs : ann->hidden;
+        l.tiles  = (l.rows + tile_rows - 1) / tile_rows;
+
+        // padding rows keep zero weights, their outputs are never read
+        const size_t tile_size = tile_rows * (l.fan_in + 1);
+        l.packed.assign(l.tiles * tile_size, 0.0);
+        for (int j { 0 }; j < l.rows; ++j)
+        {
+            double* tile = l.packed.data() + (j / tile_rows) * tile_size;
+            for (int k { 0 }; k <= l.fan_in; ++k)
+                tile[k * tile_rows + j % tile_rows] = *w++;
+        }
+    }
+}
+
+const double *blocked_net::run_batch(const double *inputs, size_t count)
+{
+    const double* in = inputs;
+    size_t in_stride = m_inputs;
+    for (size_t h { 0 }; h < m_layers.size(); ++h)
+    {
+        const layer& l = m_layers[h];
+        auto& values = m_values[h];
+        values.resize(count * l.tiles * tile_rows);
+
+        if (m_pool && (size_t)l.rows * l.fan_in * count >= parallel_work * m_pool->size() && l.tiles > 1)
+        {
+            const unsigned threads = m_pool->size();
+            m_pool->run([&](unsigned index)
+            {
+                run_tiles(l, in, in_stride, values.data(), count, l.tiles * index / threads, l.tiles * (index + 1) / threads);
+            });
+        }
+        else
+            run_tiles(l, in, in_stride, values.data(), count, 0, l.tiles);
+
+        in = values.data();
+        in_stride = l.tiles * tile_rows;
+    }
+
+    m_outputs.resize(count * m_output_count);
+    for (size_t s { 0 }; s < count; ++s)
+        std::copy(in + s * in_stride, in + s * in_stride + m_output_count, m_outputs.data() + s * m_output_count);
+
+    return m_outputs.data();
+}
+
+void blocked_net::run_tiles(const layer &l, const double *in, size_t in_stride, double *out, size_t count, int first_tile, int last_tile) const
+{
+    const size_t out_stride = l.tiles * tile_rows;
+    const size_t tile_size  = tile_rows * (l.fan_in + 1);
+
+    // a block of a tile's weights stays in L1 while it serves every sample
+    for (int k0 { 0 }; k0 < l.fan_in; k0 += tile_inputs)
+    {
+        const int k1 = std::min(k0 + tile_inputs, l.fan_in);
+        for (int t { first_tile }; t < last_tile; ++t)
+        {
+            const double* tile = l.packed.data() + t * tile_size;
+            double* tile_out = out + t * tile_rows;
+
+            size_t s { 0 };
+            for (; s + 2 <= count; s += 2)
+                tile_block_pair(tile, k0, k1, in + s * in_stride, in_stride, tile_out + s * out_stride, out_stride);
+            for (; s < count; ++s)
+                tile_block(tile, k0, k1, in + s * in_stride, tile_out + s * out_stride);
+        }
+    }
+
+    for (size_t s { 0 }; s < count; ++s)
+    {
+        double* sums = out + s * out_stride;
+        for (int j { first_tile * tile_rows }; j < last_tile * tile_rows; ++j)
+            sums[j] = l.output ? genann_act_sigmoid(nullptr, sums[j]) : genann_act_relu(nullptr, sums[j]);
+    }
+}
@@ -0,0 +1,80 @@
+/*
+blocked_net.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef BLOCKED_NET_HPP
+#define BLOCKED_NET_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "genann.h"
+#include "shard_pool.hpp"
+
+// A genann net repacked once for wide layers : each layer is cut into tiles
+// of tile_rows neurons whose weights are stored input by input, so that a
+// tile's sums are carried in registers side by side while its inputs stream
+// by. Batches are run as one matrix product per layer, each tile's weights
+// (a block of inputs at a time) serving every sample while they are in L1.
+// Every sum still adds its terms in genann_run's order : the outputs are the
+// same, bit for bit.
+//
+// With more than one thread, the tiles of layers with enough work are split
+// between them.
+class blocked_net
+{
+public:
+    static const int tile_rows   = 8;
+    static const int tile_inputs = 256; // inputs per cache block
+
+    explicit blocked_net(unsigned threads = 1);
+
+    // Repacks ann as it is now : recompile after any change to its weights.
+    void compile(const genann* ann);
+
+    // The outputs, valid until the next run.
+    const double* run(const double* inputs)
+    { return run_batch(inputs, 1); }
+    // count input vectors one after the other, their outputs likewise.
+    const double* run_batch(const double* inputs, size_t count);
+
+private:
+    struct layer
+    {
+        int rows, fan_in, tiles;
+        bool output;
+        std::vector<double> packed; // per tile : biases, then the weights of each input
+    };
+
+    void run_tiles(const layer& l, const double* in, size_t in_stride, double* out, size_t count, int first_tile, int last_tile) const;
+
+    std::vector<layer> m_layers;
+    std::vector<std::vector<double>> m_values; // per layer, count rows of its tiles * tile_rows
+    std::vector<double> m_outputs;
+    int m_inputs  { 0 };
+    int m_output_count { 0 };
+    std::unique_ptr<shard_pool> m_pool;
+};
+
+#endif // BLOCKED_NET_HPP
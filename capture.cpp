@@ -0,0 +1,369 @@
+/*
+capture.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "capture.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include <SFML/Graphics/RenderTexture.hpp>
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Window/Context.hpp>
+
+#if defined(_WIN32) && !defined(_WIN64)
+#define GL_CALL __stdcall
+#else
+#define GL_CALL
+#endif
+
+namespace
+{
+
+// OpenGL 2.1 pixel buffer objects, loaded through SFML rather than linked
+const unsigned gl_pixel_pack_buffer = 0x88EB;
+const unsigned gl_stream_read       = 0x88E1;
+const unsigned gl_read_only         = 0x88B8;
+const unsigned gl_rgba              = 0x1908;
+const unsigned gl_unsigned_byte     = 0x1401;
+
+struct gl_functions
+{
+    void  (GL_CALL *gen_buffers)(int, unsigned*) { nullptr };
+    void  (GL_CALL *delete_buffers)(int, const unsigned*) { nullptr };
+    void  (GL_CALL *bind_buffer)(unsigned, unsigned) { nullptr };
+    void  (GL_CALL *buffer_data)(unsigned, std::ptrdiff_t, const void*, unsigned) { nullptr };
+    void* (GL_CALL *map_buffer)(unsigned, unsigned) { nullptr };
+    unsigned char (GL_CALL *unmap_buffer)(unsigned) { nullptr };
+    void  (GL_CALL *read_pixels)(int, int, int, int, unsigned, unsigned, void*) { nullptr };
+};
+gl_functions gl;
+
+template <typename Function>
+bool load(Function& function, const char* name)
+{
+    function = reinterpret_cast<Function>(sf::Context::getFunction(name));
+    return function != nullptr;
+}
+
+// full range BT.601, as the C420jpeg tag says
+uint8_t luma(const uint8_t* pixel)
+{
+    return (uint8_t)((77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8);
+}
+
+}
+
+frame_capture::~frame_capture()
+{
+    close();
+}
+
+bool frame_capture::open(const std::string &path, unsigned width, unsigned height, unsigned fps, size_t max_bytes)
+{
+    close();
+
+    m_path   = path;
+    m_y4m    = path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+    m_width  = width + width % 2;
+    m_height = height + height % 2;
+    m_fps    = fps;
+    m_frames = m_dropped = 0;
+    if (m_width == 0 || m_height == 0 || m_fps == 0)
+    {
+        fprintf(stderr, "%s: empty capture size or frame rate\n", path.c_str());
+        return false;
+    }
+
+    if (m_y4m)
+    {
+        if (!(m_video = fopen(path.c_str(), "wb")))
+        {
+            perror(path.c_str());
+            return false;
+        }
+        fprintf(m_video, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", m_width, m_height, m_fps);
+    }
+    else
+    {
+        // the frames go to an existing directory
+        auto probe = path + "/000000.png";
+        FILE* file = fopen(probe.c_str(), "wb");
+        if (!file)
+        {
+            perror(probe.c_str());
+            return false;
+        }
+        fclose(file);
+        std::remove(probe.c_str());
+    }
+
+    m_pool.clear();
+    m_free.clear();
+    m_queue.clear();
+    m_max_frames = std::max<size_t>(max_bytes / ((size_t)m_width * m_height * 4), readback_slots + 1);
+    m_target = nullptr;
+    m_readback_tried = false;
+    m_closing = false;
+    m_encoder = std::thread(&frame_capture::encode, this);
+
+    return true;
+}
+
+void frame_capture::close()
+{
+    if (!is_open())
+        return;
+
+    // the readbacks still in flight, oldest first
+    if (m_async && m_target && m_target->setActive(true))
+    {
+        for (size_t i { 0 }; i < readback_slots; ++i)
+        {
+            size_t slot = (m_frames + i) % readback_slots;
+            if (m_pending[slot] >= 0)
+                collect(slot);
+        }
+    }
+    release_readback();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_ready.notify_one();
+    m_encoder.join();
+
+    if (m_video)
+    {
+        fclose(m_video);
+        m_video = nullptr;
+    }
+    if (m_dropped)
+        fprintf(stderr, "%s: %llu of %llu frames dropped, the encoder couldn't keep up\n", m_path.c_str(), m_dropped, m_frames);
+}
+
+void frame_capture::capture(sf::RenderTexture &target)
+{
+    const unsigned long long index = m_frames++;
+    m_target = &target;
+    if (!m_readback_tried)
+    {
+        m_readback_tried = true;
+        m_async = target.setActive(true) && init_readback();
+    }
+
+    if (!m_async)
+    {
+        frame* free_frame = acquire();
+        if (!free_frame)
+        {
+            ++m_dropped;
+            return;
+        }
+        auto image = target.getTexture().copyToImage();
+        std::memcpy(free_frame->pixels.data(), image.getPixelsPtr(), free_frame->pixels.size());
+        free_frame->index = index;
+        submit(free_frame);
+        return;
+    }
+
+    if (!target.setActive(true))
+    {
+        ++m_dropped;
+        return;
+    }
+
+    // the slot's previous readback was started readback_slots frames ago
+    const size_t slot = index % readback_slots;
+    if (m_pending[slot] >= 0)
+        collect(slot);
+
+    gl.bind_buffer(gl_pixel_pack_buffer, m_pbo[slot]);
+    gl.read_pixels(0, 0, (int)m_width, (int)m_height, gl_rgba, gl_unsigned_byte, nullptr);
+    gl.bind_buffer(gl_pixel_pack_buffer, 0);
+    m_pending[slot] = (long long)index;
+}
+
+bool frame_capture::init_readback()
+{
+    if (!load(gl.gen_buffers, "glGenBuffers") || !load(gl.delete_buffers, "glDeleteBuffers") ||
+        !load(gl.bind_buffer, "glBindBuffer") || !load(gl.buffer_data, "glBufferData") ||
+        !load(gl.map_buffer, "glMapBuffer") || !load(gl.unmap_buffer, "glUnmapBuffer") ||
+        !load(gl.read_pixels, "glReadPixels"))
+    {
+        fprintf(stderr, "%s: no pixel buffer objects, frames are read back synchronously\n", m_path.c_str());
+        return false;
+    }
+
+    gl.gen_buffers((int)readback_slots, m_pbo);
+    for (size_t i { 0 }; i < readback_slots; ++i)
+    {
+        gl.bind_buffer(gl_pixel_pack_buffer, m_pbo[i]);
+        gl.buffer_data(gl_pixel_pack_buffer, (std::ptrdiff_t)m_width * m_height * 4, nullptr, gl_stream_read);
+        m_pending[i] = -1;
+    }
+    gl.bind_buffer(gl_pixel_pack_buffer, 0);
+
+    return true;
+}
+
+void frame_capture::release_readback()
+{
+    if (m_async && m_target && m_target->setActive(true))
+        gl.delete_buffers((int)readback_slots, m_pbo);
+    m_async = false;
+    for (auto& pending : m_pending)
+        pending = -1;
+}
+
+void frame_capture::collect(size_t slot)
+{
+    frame* free_frame = acquire();
+    gl.bind_buffer(gl_pixel_pack_buffer, m_pbo[slot]);
+    const auto* mapped = free_frame ? static_cast<const uint8_t*>(gl.map_buffer(gl_pixel_pack_buffer, gl_read_only)) : nullptr;
+    if (mapped)
+    {
+        // opengl rows go bottom up
+        const size_t row = (size_t)m_width * 4;
+        for (unsigned y { 0 }; y < m_height; ++y)
+            std::memcpy(free_frame->pixels.data() + y * row, mapped + (m_height - 1 - y) * row, row);
+        gl.unmap_buffer(gl_pixel_pack_buffer);
+
+        free_frame->index = (unsigned long long)m_pending[slot];
+        submit(free_frame);
+    }
+    else
+    {
+        ++m_dropped;
+        if (free_frame)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(free_frame);
+        }
+    }
+    gl.bind_buffer(gl_pixel_pack_buffer, 0);
+    m_pending[slot] = -1;
+}
+
+frame_capture::frame *frame_capture::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free.empty())
+        {
+            frame* free_frame = m_free.back();
+            m_free.pop_back();
+            return free_frame;
+        }
+    }
+
+    // only this thread grows the pool, the encoder just hands frames back
+    if (m_pool.size() >= m_max_frames)
+        return nullptr;
+    m_pool.emplace_back();
+    m_pool.back().pixels.resize((size_t)m_width * m_height * 4);
+    return &m_pool.back();
+}
+
+void frame_capture::submit(frame *filled)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(filled);
+    }
+    m_ready.notify_one();
+}
+
+void frame_capture::encode()
+{
+    bool failed = false;
+    for (;;)
+    {
+        frame* next;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [this] { return !m_queue.empty() || m_closing; });
+            if (m_queue.empty())
+                return;
+            next = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        // a failed write is reported once, the frames after it are discarded
+        if (!failed && !(m_y4m ? write_y4m(*next) : write_png(*next)))
+        {
+            fprintf(stderr, "%s: cannot write frame %llu, the capture stops there\n", m_path.c_str(), next->index);
+            failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(next);
+    }
+}
+
+bool frame_capture::write_png(const frame &filled)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%06llu.png", filled.index);
+
+    sf::Image image;
+    image.create(m_width, m_height, filled.pixels.data());
+    return image.saveToFile(m_path + name);
+}
+
+bool frame_capture::write_y4m(const frame &filled)
+{
+    const size_t pixels = (size_t)m_width * m_height;
+    m_planes.resize(pixels + pixels / 2);
+    uint8_t* y_plane  = m_planes.data();
+    uint8_t* cb_plane = y_plane + pixels;
+    uint8_t* cr_plane = cb_plane + pixels / 4;
+
+    const uint8_t* rgba = filled.pixels.data();
+    for (size_t i { 0 }; i < pixels; ++i)
+        y_plane[i] = luma(rgba + 4 * i);
+
+    // chroma of each 2x2 block, from its mean color
+    const unsigned chroma_width = m_width / 2;
+    for (unsigned y { 0 }; y < m_height / 2; ++y)
+    {
+        const uint8_t* top    = rgba + (size_t)(2 * y) * m_width * 4;
+        const uint8_t* bottom = top + (size_t)m_width * 4;
+        for (unsigned x { 0 }; x < chroma_width; ++x)
+        {
+            int rgb[3];
+            for (int c { 0 }; c < 3; ++c)
+                rgb[c] = top[8*x + c] + top[8*x + 4 + c] + bottom[8*x + c] + bottom[8*x + 4 + c];
+
+            // 4 pixels summed : 2^8 fixed point scales over 4 * 2^8
+            int cb = (-43 * rgb[0] - 85 * rgb[1] + 128 * rgb[2] + 512) >> 10;
+            int cr = (128 * rgb[0] - 107 * rgb[1] - 21 * rgb[2] + 512) >> 10;
+            cb_plane[(size_t)y * chroma_width + x] = (uint8_t)std::min(std::max(cb + 128, 0), 255);
+            cr_plane[(size_t)y * chroma_width + x] = (uint8_t)std::min(std::max(cr + 128, 0), 255);
+        }
+    }
+
+    return fputs("FRAME\n", m_video) >= 0 && fwrite(m_planes.data(), 1, m_planes.size(), m_video) == m_planes.size();
+}
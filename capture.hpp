@@ -0,0 +1,129 @@
+/*
+capture.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+
+namespace sf
+{
+class RenderTexture;
+}
+
+// Records the frames of a render texture as a png sequence (path being a
+// directory, frames named 000000.png and up) or a raw y4m video (path
+// ending in .y4m, 4:2:0 full range, playable with mpv or ffmpeg -i).
+//
+// The drawing thread only starts an asynchronous readback of each frame into
+// a pixel buffer object and copies out the one started two frames before,
+// which the GPU is done with. A background thread encodes the copies, taken
+// from a pool of pixel buffers growing while the encoder lags behind : once
+// it holds max_bytes, frames are dropped rather than waited for (see dropped()).
+// Without pixel buffer objects, frames are read back synchronously.
+class frame_capture
+{
+public:
+    frame_capture() = default;
+    frame_capture(const frame_capture&) = delete;
+    frame_capture& operator=(const frame_capture&) = delete;
+    ~frame_capture();
+
+    // width and height are rounded up to even for the y4m chroma planes.
+    bool open(const std::string& path, unsigned width, unsigned height, unsigned fps, size_t max_bytes = 1ull << 30);
+    // Waits for every queued frame to be written. Call it while the captured
+    // render texture still exists.
+    void close();
+    bool is_open() const
+    { return m_encoder.joinable(); }
+
+    // Queues what has been drawn on target, which must be open()'s size and
+    // display()ed already. Call from the thread target is drawn from.
+    void capture(sf::RenderTexture& target);
+
+    unsigned width() const
+    { return m_width; }
+    unsigned height() const
+    { return m_height; }
+    unsigned long long frames() const
+    { return m_frames; }
+    unsigned long long dropped() const
+    { return m_dropped; }
+
+private:
+    struct frame
+    {
+        std::vector<uint8_t> pixels; // rgba, top row first
+        unsigned long long index { 0 };
+    };
+
+    bool init_readback();
+    void release_readback();
+    // Copies the pixel buffer object of an earlier readback to the pool.
+    void collect(size_t slot);
+    // A free pool buffer, or null if none is left and the pool is full.
+    frame* acquire();
+    void submit(frame* filled);
+
+    void encode();
+    bool write_png(const frame& filled);
+    bool write_y4m(const frame& filled);
+
+    std::string m_path;
+    bool m_y4m { false };
+    unsigned m_width { 0 };
+    unsigned m_height { 0 };
+    unsigned m_fps { 0 };
+    unsigned long long m_frames { 0 };
+    unsigned long long m_dropped { 0 };
+
+    // readback ring, frame index of each pending slot (-1 if none)
+    static const size_t readback_slots = 2;
+    unsigned m_pbo[readback_slots] {};
+    long long m_pending[readback_slots] { -1, -1 };
+    bool m_async { false };
+    bool m_readback_tried { false };
+    sf::RenderTexture* m_target { nullptr }; // of the last capture(), whose context owns the buffer objects
+
+    std::deque<frame> m_pool;        // stable addresses as it grows
+    size_t m_max_frames { 0 };
+    std::vector<frame*> m_free;
+    std::deque<frame*> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    bool m_closing { false };
+    std::thread m_encoder;
+
+    FILE* m_video { nullptr };
+    std::vector<uint8_t> m_planes; // y4m scratch, encoder thread only
+};
+
+#endif // CAPTURE_HPP
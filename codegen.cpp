@@ -0,0 +1,133 @@
+/*
+codegen.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "codegen.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+#include "genann.h"
+
+namespace
+{
+
+std::string guard_name(const std::string& name)
+{
+    std::string guard = name + "_HPP";
+    std::transform(guard.begin(), guard.end(), guard.begin(), [](unsigned char c) { return std::isalnum(c) ? std::toupper(c) : '_'; });
+    return guard;
+}
+
+// One layer : neuron `first_out + j` = act(-w_bias + sum(w_k * in_k)), in genann's weight order
+int write_layer(FILE* out, int weight, int first_in, int in_count, int first_out, int out_count,
+                int input_count, const char* activation)
+{
+    for (int j { 0 }; j < out_count; ++j)
+    {
+        fprintf(out, "    const double n%d = %s(weights[%d] * -1.0", first_out + j, activation, weight++);
+        for (int k { 0 }; k < in_count; ++k)
+        {
+            int neuron = first_in + k;
+            if (neuron < input_count)
+                fprintf(out, "\n        + weights[%d] * in[%d]", weight++, neuron);
+            else
+                fprintf(out, "\n        + weights[%d] * n%d", weight++, neuron);
+        }
+        fprintf(out, ");\n");
+    }
+    return weight;
+}
+
+}
+
+void write_network_header(const genann *ann, FILE *out, const std::string &name)
+{
+    const std::string guard = guard_name(name);
+
+    fprintf(out, "// Generated by NeuralNetworkTrainer export, do not edit.\n");
+    fprintf(out, "// %d inputs, %d hidden layer(s) of %d neurons, %d outputs.\n", ann->inputs, ann->hidden_layers, ann->hidden, ann->outputs);
+    fprintf(out, "#ifndef %s\n#define %s\n\n#include <cmath>\n\n", guard.c_str(), guard.c_str());
+    fprintf(out, "namespace %s\n{\n\n", name.c_str());
+    fprintf(out, "constexpr int inputs  = %d;\nconstexpr int outputs = %d;\n\n", ann->inputs, ann->outputs);
+
+    fprintf(out, "constexpr double weights[%d] =\n{", ann->total_weights);
+    for (int i { 0 }; i < ann->total_weights; ++i)
+        fprintf(out, "%s%.17g,", i % 4 ? " " : "\n    ", ann->weight[i]);
+    fprintf(out, "\n};\n\n");
+
+    // same activations as genann.c (ELU hidden, clamped sigmoid output)
+    fprintf(out, "inline double hidden_activation(double a)\n{ return a > 0 ? a : 1 * (std::exp(a) - 1); }\n\n");
+    fprintf(out, "inline double output_activation(double a)\n{\n"
+                 "    if (a < -15.0) return 0;\n    if (a > 15.0) return 1;\n    return 1.0 / (1 + std::exp(-a));\n}\n\n");
+
+    fprintf(out, "inline void run(const double* in, double* out)\n{\n");
+
+    int weight = 0;
+    int first_in = 0;
+    int in_count = ann->inputs;
+    int first_out = ann->inputs;
+    for (int h { 0 }; h < ann->hidden_layers; ++h)
+    {
+        weight = write_layer(out, weight, first_in, in_count, first_out, ann->hidden, ann->inputs, "hidden_activation");
+        first_in = first_out;
+        in_count = ann->hidden;
+        first_out += ann->hidden;
+    }
+    weight = write_layer(out, weight, first_in, in_count, first_out, ann->outputs, ann->inputs, "output_activation");
+
+    fprintf(out, "\n");
+    for (int j { 0 }; j < ann->outputs; ++j)
+        fprintf(out, "    out[%d] = n%d;\n", j, first_out + j);
+    fprintf(out, "}\n\n}\n\n#endif // %s\n", guard.c_str());
+}
+
+void write_network_check(const genann *ann, FILE *out, const std::string &name,
+                         const std::string &header_path, const std::string &genome_path)
+{
+    fprintf(out, "// Generated by NeuralNetworkTrainer export : checks %s against genann_run.\n", header_path.c_str());
+    fprintf(out, "// Build with : c++ -O2 <this file> genann.c -I<repo>\n\n");
+    fprintf(out, "#include <cmath>\n#include <cstdio>\n#include <cstdlib>\n\n");
+    fprintf(out, "#include \"genann.h\"\n#include \"%s\"\n\n", header_path.c_str());
+    fprintf(out, "int main()\n{\n");
+    fprintf(out, "    FILE* file = fopen(\"%s\", \"r\");\n", genome_path.c_str());
+    fprintf(out, "    genann* ann = file ? genann_read(file) : nullptr;\n");
+    fprintf(out, "    if (!ann || ann->total_weights != %d)\n    {\n"
+                 "        fprintf(stderr, \"cannot reload %s\\n\");\n        return EXIT_FAILURE;\n    }\n\n",
+            ann->total_weights, genome_path.c_str());
+    fprintf(out, "    int failures = 0;\n");
+    fprintf(out, "    for (int sample = 0; sample < 100000; ++sample)\n    {\n");
+    fprintf(out, "        double in[%s::inputs], out[%s::outputs];\n", name.c_str(), name.c_str());
+    fprintf(out, "        for (double& value : in)\n"
+                 "            value = (std::rand() / (double)RAND_MAX - 0.5) * (sample < 50000 ? 2.0 : 2000.0);\n\n");
+    fprintf(out, "        %s::run(in, out);\n", name.c_str());
+    fprintf(out, "        const double* expected = genann_run(ann, in);\n\n");
+    fprintf(out, "        for (int j = 0; j < %s::outputs; ++j)\n        {\n", name.c_str());
+    fprintf(out, "            if (!(std::abs(out[j] - expected[j]) <= 1e-12))\n            {\n"
+                 "                if (failures++ < 10)\n"
+                 "                    fprintf(stderr, \"sample %%d output %%d : %%.17g != %%.17g\\n\", sample, j, out[j], expected[j]);\n"
+                 "            }\n        }\n    }\n\n");
+    fprintf(out, "    printf(\"%%s\\n\", failures ? \"MISMATCH\" : \"OK\");\n");
+    fprintf(out, "    genann_free(ann);\n    return failures ? EXIT_FAILURE : EXIT_SUCCESS;\n}\n");
+}
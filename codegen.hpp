@@ -0,0 +1,44 @@
+/*
+codegen.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef CODEGEN_HPP
+#define CODEGEN_HPP
+
+#include <cstdio>
+#include <string>
+
+struct genann;
+
+// Writes a self-contained header computing exactly what genann_run does for
+// this network : weights become constexpr constants, every loop is unrolled
+// and the forward pass needs no allocation. The entry point is
+//   void <name>::run(const double* inputs, double* outputs);
+void write_network_header(const genann* ann, FILE* out, const std::string& name);
+
+// Writes a small program that includes the generated header, reloads the
+// genome it came from and checks both against each other on random inputs.
+void write_network_check(const genann* ann, FILE* out, const std::string& name,
+                         const std::string& header_path, const std::string& genome_path);
+
+#endif // CODEGEN_HPP
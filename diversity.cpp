@@ -0,0 +1,179 @@
+/*
+diversity.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "diversity.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+double squared_distance(const double *a, const double *b, size_t count)
+{
+    size_t i = 0;
+    double total = 0;
+
+#if defined(__AVX__)
+    // two accumulators hide the latency of the adds
+    __m256d sum_0 = _mm256_setzero_pd(), sum_1 = _mm256_setzero_pd();
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256d d_0 = _mm256_sub_pd(_mm256_loadu_pd(a + i),     _mm256_loadu_pd(b + i));
+        __m256d d_1 = _mm256_sub_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+        sum_0 = _mm256_add_pd(sum_0, _mm256_mul_pd(d_0, d_0));
+        sum_1 = _mm256_add_pd(sum_1, _mm256_mul_pd(d_1, d_1));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sum_0, sum_1));
+    total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+    __m128d sum_0 = _mm_setzero_pd(), sum_1 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128d d_0 = _mm_sub_pd(_mm_loadu_pd(a + i),     _mm_loadu_pd(b + i));
+        __m128d d_1 = _mm_sub_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2));
+        sum_0 = _mm_add_pd(sum_0, _mm_mul_pd(d_0, d_0));
+        sum_1 = _mm_add_pd(sum_1, _mm_mul_pd(d_1, d_1));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum_0, sum_1));
+    total = lanes[0] + lanes[1];
+#endif
+
+    for (; i < count; ++i)
+    {
+        double d = a[i] - b[i];
+        total += d * d;
+    }
+    return total;
+}
+
+diversity_stats measure_diversity(const std::vector<const genann*>& genomes, const diversity_params& params, uint64_t seed)
+{
+    diversity_stats stats;
+    const size_t count = genomes.size();
+    if (count == 0)
+        return stats;
+
+    const size_t weights = genomes[0]->total_weights;
+    std::vector<double> block(count * weights);
+    for (size_t i { 0 }; i < count; ++i)
+        std::memcpy(&block[i * weights], genomes[i]->weight, sizeof(double) * weights);
+    auto row = [&](size_t i) { return block.data() + i * weights; };
+    auto distance = [&](size_t i, size_t j) { return std::sqrt(squared_distance(row(i), row(j), weights) / weights); };
+
+    // per gene : mean then variance, a row at a time
+    std::vector<double> mean(weights, 0.0);
+    stats.gene_variance.assign(weights, 0.0);
+    for (size_t i { 0 }; i < count; ++i)
+    {
+        for (size_t w { 0 }; w < weights; ++w)
+            mean[w] += row(i)[w];
+    }
+    for (auto& value : mean)
+        value /= count;
+    for (size_t i { 0 }; i < count; ++i)
+    {
+        for (size_t w { 0 }; w < weights; ++w)
+        {
+            double d = row(i)[w] - mean[w];
+            stats.gene_variance[w] += d * d;
+        }
+    }
+    for (size_t w { 0 }; w < weights; ++w)
+    {
+        // every genome equal on it, whatever the rounding of the mean
+        bool fixed = true;
+        for (size_t i { 1 }; i < count && fixed; ++i)
+            fixed = row(i)[w] == row(0)[w];
+
+        double& variance = stats.gene_variance[w];
+        variance = fixed ? 0.0 : variance / count;
+        stats.mean_gene_variance += variance / weights;
+        stats.max_gene_variance = std::max(stats.max_gene_variance, variance);
+        stats.fixed_genes += fixed;
+    }
+
+    std::mt19937_64 engine(seed);
+
+    const size_t all_pairs = count * (count - 1) / 2;
+    std::vector<double> distances;
+    if (all_pairs <= params.max_pairs)
+    {
+        distances.reserve(all_pairs);
+        for (size_t i { 0 }; i < count; ++i)
+        {
+            for (size_t j { i + 1 }; j < count; ++j)
+                distances.push_back(distance(i, j));
+        }
+    }
+    else
+    {
+        distances.reserve(params.max_pairs);
+        std::uniform_int_distribution<size_t> pick(0, count - 1);
+        for (size_t p { 0 }; p < params.max_pairs; ++p)
+        {
+            size_t i = pick(engine), j = pick(engine);
+            while (j == i)
+                j = pick(engine);
+            distances.push_back(distance(i, j));
+        }
+    }
+    stats.pairs = distances.size();
+    if (stats.pairs)
+    {
+        double total = 0;
+        for (double d : distances)
+            total += d;
+        stats.mean_distance = total / stats.pairs;
+        std::nth_element(distances.begin(), distances.begin() + stats.pairs / 2, distances.end());
+        stats.median_distance = distances[stats.pairs / 2];
+    }
+
+    // leader clustering : a genome joins the first cluster whose leader is close enough
+    std::vector<size_t> clustered(count);
+    for (size_t i { 0 }; i < count; ++i)
+        clustered[i] = i;
+    if (count > params.max_clustered)
+    {
+        std::shuffle(clustered.begin(), clustered.end(), engine);
+        clustered.resize(params.max_clustered);
+    }
+    std::vector<size_t> leaders;
+    for (size_t i : clustered)
+    {
+        bool joined = std::any_of(leaders.begin(), leaders.end(), [&](size_t leader)
+        { return distance(i, leader) <= params.cluster_radius; });
+        if (!joined)
+            leaders.push_back(i);
+    }
+    stats.clusters = leaders.size();
+
+    return stats;
+}
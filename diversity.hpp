@@ -0,0 +1,64 @@
+/*
+diversity.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef DIVERSITY_HPP
+#define DIVERSITY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "genann.h"
+
+// Distances between genomes are root mean square weight differences, so
+// that they compare across topologies : two fresh random nets are about
+// 0.41 apart, a single replaced weight of a 100 weight net moves it by ~0.04.
+struct diversity_params
+{
+    size_t max_pairs       { 4096 }; // pairs measured, sampled beyond that
+    size_t max_clustered   { 256 };  // genomes clustered, sampled beyond that
+    double cluster_radius  { 0.05 }; // distance from a cluster's first genome to join it
+};
+
+struct diversity_stats
+{
+    double mean_distance   { 0 };     // over the pairs measured
+    double median_distance { 0 };     // the same, blind to a few outliers like random immigrants
+    size_t pairs         { 0 };
+    std::vector<double> gene_variance; // per weight, over the population
+    double mean_gene_variance { 0 };
+    double max_gene_variance  { 0 };
+    size_t fixed_genes { 0 };          // weights every genome agrees on
+    size_t clusters    { 0 };          // leader clustering of the genomes clustered
+};
+
+// Sum of the squared differences of a[0..count[ and b[0..count[, vectorized.
+double squared_distance(const double* a, const double* b, size_t count);
+
+// Measures genomes of the same topology, copied first into one contiguous
+// block. Sampling draws from a generator seeded with `seed`, not the
+// caller's, so measuring leaves evolution unchanged.
+diversity_stats measure_diversity(const std::vector<const genann*>& genomes, const diversity_params& params, uint64_t seed);
+
+#endif // DIVERSITY_HPP
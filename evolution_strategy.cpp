@@ -0,0 +1,415 @@
+/*
+evolution_strategy.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "evolution_strategy.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "playfield.hpp"
+#include "random.hpp"
+
+#include "genann.h"
+
+namespace
+{
+
+// Above it cma_es adapts a diagonal covariance only (sep-CMA-ES, Ros and
+// Hansen 2008) : a full one takes n² doubles and its decompositions n³.
+const int full_covariance_limit = 1000;
+
+// sum of a[i] * b[i]
+double dot(const double* a, const double* b, int count)
+{
+    int i = 0;
+    double total = 0;
+
+#if defined(__AVX__)
+    __m256d sum_0 = _mm256_setzero_pd(), sum_1 = _mm256_setzero_pd();
+    for (; i + 8 <= count; i += 8)
+    {
+        sum_0 = _mm256_add_pd(sum_0, _mm256_mul_pd(_mm256_loadu_pd(a + i),     _mm256_loadu_pd(b + i)));
+        sum_1 = _mm256_add_pd(sum_1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sum_0, sum_1));
+    total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+    __m128d sum_0 = _mm_setzero_pd(), sum_1 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4)
+    {
+        sum_0 = _mm_add_pd(sum_0, _mm_mul_pd(_mm_loadu_pd(a + i),     _mm_loadu_pd(b + i)));
+        sum_1 = _mm_add_pd(sum_1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum_0, sum_1));
+    total = lanes[0] + lanes[1];
+#endif
+
+    for (; i < count; ++i)
+        total += a[i] * b[i];
+    return total;
+}
+
+// out[i] += factor * x[i]
+void add_scaled(double* out, const double* x, double factor, int count)
+{
+    int i = 0;
+
+#if defined(__AVX__)
+    const __m256d scale = _mm256_set1_pd(factor);
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(out + i), _mm256_mul_pd(scale, _mm256_loadu_pd(x + i))));
+#elif defined(__SSE2__)
+    const __m128d scale = _mm_set1_pd(factor);
+    for (; i + 2 <= count; i += 2)
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(out + i), _mm_mul_pd(scale, _mm_loadu_pd(x + i))));
+#endif
+
+    for (; i < count; ++i)
+        out[i] += factor * x[i];
+}
+
+// Eigen decomposition of the symmetric n x n matrix a (row major) by cyclic
+// Jacobi rotations : a = vectors * diag(values) * vectors^T, eigenvectors in columns.
+void symmetric_eigen(std::vector<double> a, int n, std::vector<double>& vectors, std::vector<double>& values)
+{
+    vectors.assign(n * n, 0.0);
+    for (int i { 0 }; i < n; ++i)
+        vectors[i * n + i] = 1.0;
+
+    for (int sweep { 0 }; sweep < 64; ++sweep)
+    {
+        double off = 0, diagonal = 0;
+        for (int p { 0 }; p < n; ++p)
+        {
+            diagonal += a[p * n + p] * a[p * n + p];
+            for (int q { p + 1 }; q < n; ++q)
+                off += a[p * n + q] * a[p * n + q];
+        }
+        if (off <= 1e-24 * diagonal)
+            break;
+
+        for (int p { 0 }; p < n; ++p)
+        {
+            for (int q { p + 1 }; q < n; ++q)
+            {
+                double apq = a[p * n + q];
+                if (apq == 0)
+                    continue;
+
+                double theta = (a[q * n + q] - a[p * n + p]) / (2 * apq);
+                double t = (theta >= 0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                double c = 1 / std::sqrt(t * t + 1), s = t * c;
+
+                for (int k { 0 }; k < n; ++k)
+                {
+                    double akp = a[k * n + p], akq = a[k * n + q];
+                    a[k * n + p] = c * akp - s * akq;
+                    a[k * n + q] = s * akp + c * akq;
+                }
+                for (int k { 0 }; k < n; ++k)
+                {
+                    double apk = a[p * n + k], aqk = a[q * n + k];
+                    a[p * n + k] = c * apk - s * aqk;
+                    a[q * n + k] = s * apk + c * aqk;
+                }
+                for (int k { 0 }; k < n; ++k)
+                {
+                    double vkp = vectors[k * n + p], vkq = vectors[k * n + q];
+                    vectors[k * n + p] = c * vkp - s * vkq;
+                    vectors[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+
+    values.resize(n);
+    for (int i { 0 }; i < n; ++i)
+        values[i] = a[i * n + i];
+}
+
+class openai_es : public evolution_strategy
+{
+public:
+    explicit openai_es(const es_params& params)
+        : m_learning_rate(params.learning_rate)
+    { m_sigma = params.sigma; }
+
+protected:
+    void adapt(const std::vector<PlayField*>& fields) override
+    {
+        const size_t count = fields.size();
+        const size_t n = m_mean.size();
+        auto order = ranking(fields);
+
+        // centered ranks, from 0.5 for the best down to -0.5
+        m_gradient.assign(n, 0.0);
+        for (size_t rank { 0 }; rank < count; ++rank)
+        {
+            double utility = 0.5 - (double)rank / (count - 1);
+            const double* x = fields[order[rank]]->net.nn->weight;
+            for (size_t j { 0 }; j < n; ++j)
+                m_gradient[j] += utility * (x[j] - m_mean[j]);
+        }
+
+        // the samples hold sigma * noise, hence sigma squared
+        const double scale = m_learning_rate / (count * m_sigma * m_sigma);
+        for (size_t j { 0 }; j < n; ++j)
+            m_mean[j] += scale * m_gradient[j];
+    }
+
+    void draw(double* direction) override
+    {
+        for (size_t j { 0 }; j < m_mean.size(); ++j)
+            direction[j] = random_normal();
+    }
+
+private:
+    double m_learning_rate;
+    std::vector<double> m_gradient;
+};
+
+class cma_es : public evolution_strategy
+{
+public:
+    explicit cma_es(const es_params& params)
+    { m_sigma = params.sigma; }
+
+protected:
+    void adapt(const std::vector<PlayField*>& fields) override
+    {
+        const int n = (int)m_mean.size();
+        const size_t mu = std::max<size_t>(fields.size() / 2, 1);
+
+        // recombination weights, log-decreasing over the best half
+        std::vector<double> weights(mu);
+        double sum = 0, square_sum = 0;
+        for (size_t i { 0 }; i < mu; ++i)
+            sum += weights[i] = std::log(mu + 0.5) - std::log(i + 1.0);
+        for (auto& weight : weights)
+        {
+            weight /= sum;
+            square_sum += weight * weight;
+        }
+        const double mueff = 1 / square_sum;
+
+        // a diagonal covariance learns (n + 2) / 3 times faster
+        const double speedup = m_diagonal ? (n + 2) / 3.0 : 1.0;
+        const double cc    = (4 + mueff / n) / (n + 4 + 2 * mueff / n);
+        const double cs    = (mueff + 2) / (n + mueff + 5);
+        const double c1    = std::min(1.0, speedup * 2 / ((n + 1.3) * (n + 1.3) + mueff));
+        const double cmu   = std::min(1 - c1, speedup * 2 * (mueff - 2 + 1 / mueff) / ((n + 2) * (n + 2) + mueff));
+        const double damps = 1 + 2 * std::max(0.0, std::sqrt((mueff - 1) / (n + 1)) - 1) + cs;
+        const double chi_n = std::sqrt((double)n) * (1 - 1.0 / (4 * n) + 1.0 / (21.0 * n * n));
+
+        // selected steps y_i = (x_i - mean) / sigma, one row each, and their weighted mean
+        auto order = ranking(fields);
+        m_steps.assign(mu * n, 0.0);
+        std::vector<double> step(n, 0.0);
+        for (size_t i { 0 }; i < mu; ++i)
+        {
+            const double* x = fields[order[i]]->net.nn->weight;
+            double* y = &m_steps[i * n];
+            for (int j { 0 }; j < n; ++j)
+                y[j] = (x[j] - m_mean[j]) / m_sigma;
+            add_scaled(step.data(), y, weights[i], n);
+        }
+        add_scaled(m_mean.data(), step.data(), m_sigma, n);
+
+        // evolution paths, the conjugate one through C^-1/2 = B D^-1 B^T
+        std::vector<double> whitened(n, 0.0);
+        if (m_diagonal)
+        {
+            for (int j { 0 }; j < n; ++j)
+                whitened[j] = step[j] / m_scales[j];
+        }
+        else
+        {
+            std::vector<double> rotated(n, 0.0);
+            for (int j { 0 }; j < n; ++j)
+                add_scaled(rotated.data(), &m_basis[j * n], step[j], n);
+            for (int k { 0 }; k < n; ++k)
+                rotated[k] /= m_scales[k];
+            for (int j { 0 }; j < n; ++j)
+                whitened[j] = dot(&m_basis[j * n], rotated.data(), n);
+        }
+        double ps_norm = 0;
+        const double ps_rate = std::sqrt(cs * (2 - cs) * mueff);
+        for (int j { 0 }; j < n; ++j)
+        {
+            m_ps[j] = (1 - cs) * m_ps[j] + ps_rate * whitened[j];
+            ps_norm += m_ps[j] * m_ps[j];
+        }
+        ps_norm = std::sqrt(ps_norm);
+
+        ++m_generation;
+        const bool hsig = ps_norm / std::sqrt(1 - std::pow(1 - cs, 2.0 * m_generation)) / chi_n < 1.4 + 2.0 / (n + 1);
+        const double pc_rate = hsig ? std::sqrt(cc * (2 - cc) * mueff) : 0.0;
+        for (int j { 0 }; j < n; ++j)
+            m_pc[j] = (1 - cc) * m_pc[j] + pc_rate * step[j];
+
+        // rank-one and rank-mu updates
+        const double decay = 1 - c1 - cmu + (hsig ? 0.0 : c1 * cc * (2 - cc));
+        if (m_diagonal)
+        {
+            for (int j { 0 }; j < n; ++j)
+            {
+                double variance = decay * m_covariance[j] + c1 * m_pc[j] * m_pc[j];
+                for (size_t i { 0 }; i < mu; ++i)
+                    variance += cmu * weights[i] * m_steps[i * n + j] * m_steps[i * n + j];
+                m_covariance[j] = variance;
+            }
+        }
+        else
+        {
+            // the lower triangle, then mirrored
+            for (int r { 0 }; r < n; ++r)
+            {
+                double* row = &m_covariance[r * n];
+                for (int c { 0 }; c <= r; ++c)
+                    row[c] *= decay;
+                add_scaled(row, m_pc.data(), c1 * m_pc[r], r + 1);
+                for (size_t i { 0 }; i < mu; ++i)
+                {
+                    const double* y = &m_steps[i * n];
+                    add_scaled(row, y, cmu * weights[i] * y[r], r + 1);
+                }
+            }
+            for (int r { 0 }; r < n; ++r)
+            {
+                for (int c { r + 1 }; c < n; ++c)
+                    m_covariance[r * n + c] = m_covariance[c * n + r];
+            }
+        }
+
+        m_sigma *= std::exp((cs / damps) * (ps_norm / chi_n - 1));
+
+        // the eigenbasis lags behind the covariance by up to 1 / (10 n (c1 + cmu))
+        // generations (Hansen's tutorial), which keeps the O(n³) off most of them
+        const double decomposition_gap = 1 / (10 * n * (c1 + cmu));
+        if (m_diagonal || m_generation - m_decomposed_at >= decomposition_gap)
+            decompose();
+    }
+
+    void start(int n) override
+    {
+        m_diagonal = n > full_covariance_limit;
+        m_covariance.assign(m_diagonal ? n : n * n, 0.0);
+        for (int i { 0 }; i < n; ++i)
+            m_covariance[m_diagonal ? i : i * n + i] = 1.0;
+        m_pc.assign(n, 0.0);
+        m_ps.assign(n, 0.0);
+        decompose();
+    }
+
+    // B * D * z, a sample of N(0, C)
+    void draw(double* direction) override
+    {
+        const int n = (int)m_mean.size();
+        m_noise.resize(n);
+        for (int k { 0 }; k < n; ++k)
+            m_noise[k] = m_scales[k] * random_normal();
+        for (int j { 0 }; j < n; ++j)
+            direction[j] = m_diagonal ? m_noise[j] : dot(&m_basis[j * n], m_noise.data(), n);
+    }
+
+private:
+    void decompose()
+    {
+        if (m_diagonal)
+            m_scales = m_covariance;
+        else
+            symmetric_eigen(m_covariance, (int)m_mean.size(), m_basis, m_scales);
+        for (auto& scale : m_scales)
+            scale = std::sqrt(std::max(scale, 1e-20));
+        m_decomposed_at = m_generation;
+    }
+
+    bool m_diagonal { false };
+    std::vector<double> m_covariance; // C, n x n, or its diagonal only
+    std::vector<double> m_basis;      // B, eigenvectors of C in columns, identity (and empty) if diagonal
+    std::vector<double> m_scales;     // D, square roots of the eigenvalues
+    std::vector<double> m_pc, m_ps;   // evolution paths
+    std::vector<double> m_steps, m_noise;
+    int m_generation { 0 };
+    int m_decomposed_at { 0 };
+};
+
+}
+
+void evolution_strategy::sample(std::vector<PlayField *> &fields)
+{
+    const int n = fields[0]->net.nn->total_weights;
+    if (m_mean.empty())
+    {
+        m_mean.assign(fields[0]->net.nn->weight, fields[0]->net.nn->weight + n);
+        start(n);
+    }
+
+    std::vector<double> direction(n);
+    for (size_t i { 0 }; i + 1 < fields.size(); i += 2)
+    {
+        draw(direction.data());
+        double* plus  = fields[i]->net.nn->weight;
+        double* minus = fields[i + 1]->net.nn->weight;
+        for (int j { 0 }; j < n; ++j)
+        {
+            plus[j]  = m_mean[j] + m_sigma * direction[j];
+            minus[j] = m_mean[j] - m_sigma * direction[j];
+        }
+    }
+    if (fields.size() % 2)
+        std::copy(m_mean.begin(), m_mean.end(), fields.back()->net.nn->weight);
+
+    for (auto* field : fields)
+    {
+        field->restart();
+        field->set_playing(true);
+    }
+}
+
+std::vector<size_t> evolution_strategy::ranking(const std::vector<PlayField *> &fields)
+{
+    std::vector<size_t> order(fields.size());
+    for (size_t i { 0 }; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+    { return fields[lhs]->score() > fields[rhs]->score(); });
+    return order;
+}
+
+evolution_strategy *make_strategy(const std::string &name, const es_params &params)
+{
+    if (name == "openai_es")
+        return new openai_es(params);
+    if (name == "cma_es")
+        return new cma_es(params);
+    return nullptr;
+}
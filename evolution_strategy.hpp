@@ -0,0 +1,79 @@
+/*
+evolution_strategy.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef EVOLUTION_STRATEGY_HPP
+#define EVOLUTION_STRATEGY_HPP
+
+#include <string>
+#include <vector>
+
+class PlayField;
+
+struct es_params
+{
+    double sigma         { 0.1 };  // initial step size, in weight units
+    double learning_rate { 0.05 }; // openai_es only
+};
+
+// Alternative to the genetic algorithm : a search distribution over the
+// weights, centered on a mean genome. Each generation every field flies a
+// sample from it, drawn in antithetic pairs (mean + d, mean - d) so that the
+// noise cancels out of the update ; with an odd population the last field
+// flies the mean itself. The update only uses the rank of each score, so it
+// is unaffected by the scale of the environment's rewards.
+//
+// Samples are read back from the fields' weights rather than remembered, so
+// migrants written over a field after sample() are taken into account as
+// they are.
+class evolution_strategy
+{
+public:
+    virtual ~evolution_strategy() = default;
+
+    // Hands every field a new sample and restarts it. The first call
+    // centers the distribution on the net fields[0] already has.
+    void sample(std::vector<PlayField*>& fields);
+    // Moves the distribution towards the best samples of a finished generation.
+    void update(const std::vector<PlayField*>& fields)
+    { if (!m_mean.empty()) adapt(fields); }
+
+protected:
+    virtual void adapt(const std::vector<PlayField*>& fields) = 0;
+    // Fills direction with a perturbation of the mean, before scaling by m_sigma.
+    virtual void draw(double* direction) = 0;
+    virtual void start(int /*dimension*/) {}
+
+    // Indices of the fields from the best score down.
+    static std::vector<size_t> ranking(const std::vector<PlayField*>& fields);
+
+    std::vector<double> m_mean;
+    double m_sigma { 0.1 };
+};
+
+// "openai_es" (Salimans et al., centered rank gradient estimate) or
+// "cma_es" (Hansen, rank-one and rank-mu covariance updates, a diagonal
+// covariance only above a thousand weights), nullptr if unknown.
+evolution_strategy* make_strategy(const std::string& name, const es_params& params);
+
+#endif // EVOLUTION_STRATEGY_HPP
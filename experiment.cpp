@@ -0,0 +1,404 @@
+/*
+experiment.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "experiment.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+
+#include "common.hpp"
+#include "playfield.hpp"
+#include "lander.hpp"
+#include "pong.hpp"
+#include "population.hpp"
+#include "island.hpp"
+#include "island_process.hpp"
+#include "matchmaking.hpp"
+#include "mutation.hpp"
+#include "random.hpp"
+#include "stats_server.hpp"
+
+namespace
+{
+
+std::string trim(const std::string& str)
+{
+    auto first = str.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    auto last = str.find_last_not_of(" \t\r");
+    return str.substr(first, last - first + 1);
+}
+
+std::vector<std::string> split_list(const std::string& str)
+{
+    std::vector<std::string> values;
+    std::stringstream stream(str);
+    std::string value;
+    while (std::getline(stream, value, ','))
+        values.emplace_back(trim(value));
+    return values;
+}
+
+struct section
+{
+    std::string name;
+    int line { 0 };
+    std::vector<std::pair<std::string, std::vector<std::string>>> keys;
+};
+
+bool expand(const section& sec, std::vector<experiment_config>& experiments)
+{
+    // odometer over every list of the section
+    std::vector<size_t> indices(sec.keys.size(), 0);
+    while (true)
+    {
+        experiment_config config;
+        config.name = sec.name;
+        for (size_t i { 0 }; i < sec.keys.size(); ++i)
+        {
+            const auto& key   = sec.keys[i].first;
+            const auto& value = sec.keys[i].second[indices[i]];
+            if (!set_config_key(config, key, value))
+            {
+                fprintf(stderr, "[%s] line %d: invalid value '%s' for key '%s'\n", sec.name.c_str(), sec.line, value.c_str(), key.c_str());
+                return false;
+            }
+            if (sec.keys[i].second.size() > 1)
+                config.name += "/" + key + "=" + value;
+        }
+        experiments.emplace_back(config);
+
+        size_t digit = 0;
+        while (digit < indices.size() && ++indices[digit] == sec.keys[digit].second.size())
+            indices[digit++] = 0;
+        if (digit == indices.size())
+            return true;
+    }
+}
+
+}
+
+bool set_config_key(experiment_config &config, const std::string &key, const std::string &value)
+{
+    std::string* text = key == "name"               ? &config.name :
+                        key == "environment"        ? &config.environment :
+                        key == "optimizer"          ? &config.optimizer :
+                        key == "checkpoint_dir"     ? &config.checkpoint_dir :
+                        key == "record_dir"         ? &config.record_dir :
+                        key == "lineage_dir"        ? &config.lineage_dir :
+                        key == "prune_log_dir"      ? &config.prune_log_dir :
+                        key == "diversity_log_dir"  ? &config.diversity_log_dir :
+                        key == "migration_topology" ? &config.migration_topology :
+                        key == "worker_launcher"    ? &config.worker_launcher :
+                        key == "imitation_log"      ? &config.imitation_log :
+                        key == "scenario_bank"      ? &config.scenario_bank :
+                        key == "coevolution"        ? &config.coevolution :
+                        key == "mutation"           ? &config.mutation :
+                        key == "mutation_step_rule" ? &config.mutation_step_rule : nullptr;
+    if (key == "optimizer" && value != "ga" && value != "openai_es" && value != "cma_es")
+        return false;
+    if (key == "coevolution" && !value.empty() && !matchmaker::known_format(value))
+        return false;
+    if (key == "mutation" && value != "replace" && value != "gaussian")
+        return false;
+    if (key == "mutation_step_rule" && !known_step_rule(value))
+        return false;
+    if (text)
+    {
+        *text = value;
+        return true;
+    }
+
+    char* end = nullptr;
+    double number = std::strtod(value.c_str(), &end);
+    if (value.empty() || *end != '\0')
+        return false;
+
+    if      (key == "hidden_layers")     config.hidden_layers     = (int)number;
+    else if (key == "hidden_neurons")    config.hidden_neurons    = (int)number;
+    else if (key == "es_sigma")          config.es_sigma          = number;
+    else if (key == "es_learning_rate")  config.es_learning_rate  = number;
+    else if (key == "multi_objective")   config.multi_objective   = number != 0;
+    else if (key == "novelty")           config.novelty           = number != 0;
+    else if (key == "novelty_k")         config.novelty_k         = std::max<size_t>(1, (size_t)number);
+    else if (key == "novelty_archive_add") config.novelty_archive_add = (size_t)number;
+    else if (key == "novelty_threads")   config.novelty_threads   = (unsigned)number;
+    else if (key == "mutation_factor")   config.mutation_factor   = number;
+    else if (key == "mutated_genes")     config.mutated_genes     = std::max(1, (int)number);
+    else if (key == "mutation_rate")     config.mutation_rate     = std::min(std::max(number, 0.0), 1.0);
+    else if (key == "mutation_sigma")    config.mutation_sigma    = number;
+    else if (key == "connection_removal")  config.connection_removal  = number;
+    else if (key == "connection_addition") config.connection_addition = number;
+    else if (key == "sparse_inference")  config.sparse_inference  = number != 0;
+    else if (key == "blocked_inference") config.blocked_inference = number != 0;
+    else if (key == "random_immigrants") config.random_immigrants = (size_t)number;
+    else if (key == "time_limit")        config.time_limit        = (float)number;
+    else if (key == "action_repeat")     config.action_repeat     = std::max(1, (int)number);
+    else if (key == "physics_substeps")  config.physics_substeps  = std::max(1, (int)number);
+    else if (key == "event_driven")      config.event_driven      = number != 0;
+    else if (key == "terrain")           config.terrain           = number != 0;
+    else if (key == "terrain_seed")      config.terrain_seed      = (unsigned)number;
+    else if (key == "terrain_roughness") config.terrain_roughness = (float)number;
+    else if (key == "lander_rays")       config.lander_rays       = std::max(0, (int)number);
+    else if (key == "lander_ray_fan")    config.lander_ray_fan    = (float)number;
+    else if (key == "lander_ray_range")  config.lander_ray_range  = std::max(1.f, (float)number);
+    else if (key == "coevolution_opponents") config.coevolution_opponents = (size_t)number;
+    else if (key == "coevolution_threads")   config.coevolution_threads   = std::max(1u, (unsigned)number);
+    else if (key == "hall_of_fame_size")     config.hall_of_fame_size     = (size_t)number;
+    else if (key == "population")        config.population        = (size_t)number;
+    else if (key == "scenarios_per_generation") config.scenarios_per_generation = std::max<size_t>(1, (size_t)number);
+    else if (key == "generations")       config.generations       = (int)number;
+    else if (key == "time_step")         config.time_step         = (float)number;
+    else if (key == "seed")              config.seed              = (unsigned)number;
+    else if (key == "record_top")        config.record_top        = (size_t)number;
+    else if (key == "lineage_keyframe_interval") config.lineage_keyframe_interval = std::max(1, (int)number);
+    else if (key == "prune")             config.prune             = number != 0;
+    else if (key == "islands")           config.islands           = (size_t)number;
+    else if (key == "migration_interval") config.migration_interval = std::max(1, (int)number);
+    else if (key == "migrants")          config.migrants          = (size_t)number;
+    else if (key == "island_processes")  config.island_processes  = number != 0;
+    else if (key == "worker_nodes")      config.worker_nodes      = std::max(1, (int)number);
+    else if (key == "max_restarts")      config.max_restarts      = (int)number;
+    else if (key == "fitness_cache")     config.fitness_cache     = number != 0;
+    else if (key == "diversity_target")  config.diversity_target  = number;
+    else if (key == "diversity_max_pairs") config.diversity_max_pairs = std::max<size_t>(1, (size_t)number);
+    else if (key == "diversity_cluster_radius") config.diversity_cluster_radius = number;
+    else if (key == "imitation_min_score")     config.imitation_min_score     = (float)number;
+    else if (key == "imitation_epochs")        config.imitation_epochs        = (int)number;
+    else if (key == "imitation_learning_rate") config.imitation_learning_rate = number;
+    else if (key == "imitation_threads")       config.imitation_threads       = (unsigned)number;
+    else return false;
+
+    return true;
+}
+
+std::vector<std::string> config_arguments(const experiment_config &config)
+{
+    char number[64];
+    auto real = [&number](double value) { snprintf(number, sizeof(number), "%.17g", value); return std::string(number); };
+
+    return {
+        "name=" + config.name,
+        "environment=" + config.environment,
+        "optimizer=" + config.optimizer,
+        "es_sigma=" + real(config.es_sigma),
+        "es_learning_rate=" + real(config.es_learning_rate),
+        "hidden_layers=" + std::to_string(config.hidden_layers),
+        "hidden_neurons=" + std::to_string(config.hidden_neurons),
+        "multi_objective=" + std::to_string(config.multi_objective),
+        "novelty=" + std::to_string(config.novelty),
+        "novelty_k=" + std::to_string(config.novelty_k),
+        "novelty_archive_add=" + std::to_string(config.novelty_archive_add),
+        "novelty_threads=" + std::to_string(config.novelty_threads),
+        "mutation_factor=" + real(config.mutation_factor),
+        "mutated_genes=" + std::to_string(config.mutated_genes),
+        "mutation=" + config.mutation,
+        "mutation_rate=" + real(config.mutation_rate),
+        "mutation_sigma=" + real(config.mutation_sigma),
+        "mutation_step_rule=" + config.mutation_step_rule,
+        "connection_removal=" + real(config.connection_removal),
+        "connection_addition=" + real(config.connection_addition),
+        "sparse_inference=" + std::to_string(config.sparse_inference),
+        "blocked_inference=" + std::to_string(config.blocked_inference),
+        "random_immigrants=" + std::to_string(config.random_immigrants),
+        "time_limit=" + real(config.time_limit),
+        "action_repeat=" + std::to_string(config.action_repeat),
+        "physics_substeps=" + std::to_string(config.physics_substeps),
+        "event_driven=" + std::to_string(config.event_driven),
+        "terrain=" + std::to_string(config.terrain),
+        "terrain_seed=" + std::to_string(config.terrain_seed),
+        "terrain_roughness=" + real(config.terrain_roughness),
+        "lander_rays=" + std::to_string(config.lander_rays),
+        "lander_ray_fan=" + real(config.lander_ray_fan),
+        "lander_ray_range=" + real(config.lander_ray_range),
+        "coevolution=" + config.coevolution,
+        "coevolution_opponents=" + std::to_string(config.coevolution_opponents),
+        "coevolution_threads=" + std::to_string(config.coevolution_threads),
+        "hall_of_fame_size=" + std::to_string(config.hall_of_fame_size),
+        "population=" + std::to_string(config.population),
+        "scenario_bank=" + config.scenario_bank,
+        "scenarios_per_generation=" + std::to_string(config.scenarios_per_generation),
+        "generations=" + std::to_string(config.generations),
+        "time_step=" + real(config.time_step),
+        "seed=" + std::to_string(config.seed),
+        "checkpoint_dir=" + config.checkpoint_dir,
+        "record_dir=" + config.record_dir,
+        "record_top=" + std::to_string(config.record_top),
+        "lineage_dir=" + config.lineage_dir,
+        "lineage_keyframe_interval=" + std::to_string(config.lineage_keyframe_interval),
+        "islands=" + std::to_string(config.islands),
+        "migration_interval=" + std::to_string(config.migration_interval),
+        "migrants=" + std::to_string(config.migrants),
+        "migration_topology=" + config.migration_topology,
+        "island_processes=" + std::to_string(config.island_processes),
+        "worker_launcher=" + config.worker_launcher,
+        "worker_nodes=" + std::to_string(config.worker_nodes),
+        "max_restarts=" + std::to_string(config.max_restarts),
+        "prune=" + std::to_string(config.prune),
+        "prune_log_dir=" + config.prune_log_dir,
+        "fitness_cache=" + std::to_string(config.fitness_cache),
+        "diversity_log_dir=" + config.diversity_log_dir,
+        "diversity_target=" + real(config.diversity_target),
+        "diversity_max_pairs=" + std::to_string(config.diversity_max_pairs),
+        "diversity_cluster_radius=" + real(config.diversity_cluster_radius),
+        "imitation_log=" + config.imitation_log,
+        "imitation_min_score=" + real(config.imitation_min_score),
+        "imitation_epochs=" + std::to_string(config.imitation_epochs),
+        "imitation_learning_rate=" + real(config.imitation_learning_rate),
+        "imitation_threads=" + std::to_string(config.imitation_threads),
+    };
+}
+
+bool load_experiments(const std::string &path, std::vector<experiment_config> &experiments)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "cannot open experiment file '%s'\n", path.c_str());
+        return false;
+    }
+
+    std::vector<section> sections;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        ++line_number;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+
+        if (line.front() == '[' && line.back() == ']')
+        {
+            sections.emplace_back();
+            sections.back().name = trim(line.substr(1, line.size() - 2));
+            sections.back().line = line_number;
+            continue;
+        }
+
+        auto equal = line.find('=');
+        if (equal == std::string::npos || sections.empty())
+        {
+            fprintf(stderr, "%s:%d: expected 'key = value' inside a [section]\n", path.c_str(), line_number);
+            return false;
+        }
+
+        sections.back().keys.emplace_back(trim(line.substr(0, equal)), split_list(line.substr(equal + 1)));
+    }
+
+    for (const auto& sec : sections)
+    {
+        if (!expand(sec, experiments))
+            return false;
+    }
+
+    return true;
+}
+
+std::string output_path(const experiment_config &config, const std::string &directory, const char *extension)
+{
+    if (directory.empty())
+        return "";
+
+    std::string file_name = config.name;
+    std::replace(file_name.begin(), file_name.end(), '/', '_');
+    return directory + "/" + file_name + extension;
+}
+
+PlayField *make_field(const std::string &environment, sf::Vector2i size)
+{
+    if (environment == "lander")
+        return new LanderPlayField(size);
+    if (environment == "pong")
+        return new PongPlayField(size);
+    return nullptr;
+}
+
+experiment_result run_experiment(const experiment_config &config, stats_slot *live)
+{
+    if (config.islands > 1 && config.island_processes)
+        return run_island_processes(config);
+    if (config.islands > 1)
+        return run_islands(config);
+
+    seed_random(config.seed);
+
+    population pop(config);
+    if (!pop.valid())
+    {
+        experiment_result result;
+        result.name   = config.name;
+        result.failed = true;
+        return result;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int generation { 0 }; generation < config.generations; ++generation)
+    {
+        if (!live)
+        {
+            pop.run_generation();
+            continue;
+        }
+
+        auto breeding = std::chrono::steady_clock::now();
+        pop.advance();
+        auto evaluation = std::chrono::steady_clock::now();
+        pop.evaluate();
+        auto end = std::chrono::steady_clock::now();
+
+        const auto& stats = pop.stats();
+        live_stats progress;
+        progress.state            = live_stats::running;
+        progress.generation       = pop.generation();
+        progress.best_score       = stats.best_score;
+        progress.final_best       = stats.final_best;
+        progress.final_mean       = stats.final_mean;
+        progress.evaluations      = stats.evaluations;
+        progress.ticks            = stats.ticks;
+        progress.seconds          = std::chrono::duration<double>(end - start).count();
+        progress.breed_seconds    = std::chrono::duration<double>(evaluation - breeding).count();
+        progress.evaluate_seconds = std::chrono::duration<double>(end - evaluation).count();
+        live->publish(progress);
+    }
+
+    experiment_result result = pop.stats();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto champion_path = output_path(config, config.checkpoint_dir, ".net");
+    if (!champion_path.empty())
+        pop.save_champion(champion_path);
+    if (!champion_path.empty() && config.multi_objective)
+        pop.save_front(output_path(config, config.checkpoint_dir, ".front"));
+
+    return result;
+}
@@ -0,0 +1,166 @@
+/*
+experiment.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef EXPERIMENT_HPP
+#define EXPERIMENT_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <SFML/System/Vector2.hpp>
+
+class PlayField;
+class stats_slot;
+
+// Everything that used to be compiled in : one headless training run.
+struct experiment_config
+{
+    std::string name { "default" };
+    std::string environment { "lander" }; // lander or pong
+
+    std::string optimizer { "ga" }; // ga, openai_es or cma_es, see evolution_strategy.hpp
+    double es_sigma         { 0.1 };
+    double es_learning_rate { 0.05 };
+
+    int    hidden_layers     { 1 };
+    int    hidden_neurons    { 4 };
+    double mutation_factor   { 0.1 };  // chance for a child to skip mutation
+    int    mutated_genes     { 1 };    // weights replaced in a mutated child
+    std::string mutation { "replace" }; // ga : replace (mutated_genes uniform weights) or gaussian, see mutation.hpp
+    double mutation_rate     { 0.05 }; // gaussian : chance of each weight to be perturbed
+    double mutation_sigma    { 0.1 };
+    std::string mutation_step_rule { "fixed" }; // gaussian : fixed, self_adaptive or one_fifth
+    double connection_removal  { 0 };  // ga : chance for a child to lose a connection (zeroed weight)
+    double connection_addition { 0 };  // ga : chance for a child to regain one
+    bool   sparse_inference  { false }; // fly the nets through sparse_net, faster once pruned
+    bool   blocked_inference { false }; // fly them through blocked_net, faster from hidden_neurons ~16
+    bool   multi_objective   { false }; // ga : pareto selection, the final front saved as <name>.front
+    bool   novelty           { false }; // ga : parents chosen for the novelty of their behaviour rather than their score
+    size_t novelty_k         { 15 };    // neighbours averaged
+    size_t novelty_archive_add { 2 };   // most novel behaviours archived each generation
+    unsigned novelty_threads { 1 };
+    size_t random_immigrants { 3 };
+    float  time_limit        { 10.f }; // seconds per episode, 0 for no limit
+    int    action_repeat     { 1 };    // time steps between two net queries
+    int    physics_substeps  { 1 };    // physics steps per time step
+    bool   event_driven      { false }; // pong : exact collisions whatever the time step, see PongPlayField
+    bool   terrain           { false }; // lander : hills of segments instead of the flat ground
+    unsigned terrain_seed    { 0 };
+    float  terrain_roughness { 200 };   // highest hills, in pixels above the pad
+    int    lander_rays       { 0 };     // lander : distance rays fed to the net, see LanderPlayField
+    float  lander_ray_fan    { 120 };   // degrees
+    float  lander_ray_range  { 600 };
+
+    std::string coevolution;                // pong : if set, the genomes play each other, round_robin, swiss or hall_of_fame, see matchmaking.hpp
+    size_t   coevolution_opponents { 4 };   // matches per genome and generation, 0 for a full round robin
+    unsigned coevolution_threads   { 1 };
+    size_t   hall_of_fame_size     { 50 };  // past champions kept as opponents
+
+    size_t   population  { 20 };
+    std::string scenario_bank;              // if set, episodes start from this bank's scenarios, see scenario_bank.hpp
+    size_t   scenarios_per_generation { 1 }; // field i of generation g plays scenario g * this + i % this
+    int      generations { 100 };
+    float    time_step   { 1/60.f };
+    unsigned seed        { 0 };
+
+    std::string checkpoint_dir; // if set, the final champion is saved there as <name>.net
+    std::string record_dir;     // if set, lander flights are logged there as <name>.traj
+    size_t      record_top { 1 }; // best flights of each generation to log
+    std::string lineage_dir;    // if set, every evaluated genome is stored there as <name>.lineage, see lineage.hpp
+    int         lineage_keyframe_interval { 256 }; // longest chain of deltas
+
+    size_t      islands { 1 };             // sub-populations of `population` fields, see island.hpp
+    int         migration_interval { 10 }; // generations
+    size_t      migrants { 2 };            // best genomes sent on each route per migration
+    std::string migration_topology { "ring" };
+
+    bool        island_processes { false }; // islands as worker processes, see island_process.hpp
+    std::string worker_launcher;            // command prefixed to each worker, {island} and {node} substituted
+    int         worker_nodes { 1 };         // {node} is the island index modulo this
+    int         max_restarts { 3 };         // per crashed worker
+
+    bool        prune { false }; // stop rollouts that can't become parents anymore
+    std::string prune_log_dir;   // if set, pruning decisions are logged there as <name>.prune.csv
+
+    std::string diversity_log_dir;          // if set, the diversity of each generation is logged there as <name>.diversity.csv
+    double      diversity_target { 0 };     // ga : if set, mutated_genes grows while the median genome distance is below it, see diversity.hpp
+    size_t      diversity_max_pairs { 4096 };
+    double      diversity_cluster_radius { 0.05 };
+
+    bool        fitness_cache { false }; // reuse the scores of genomes already flown, deterministic environments only
+
+    std::string imitation_log;                // if set, the first parents are trained on the flights of this lander log
+    float       imitation_min_score { 0 };    // flights scoring less are not imitated
+    int         imitation_epochs { 20 };
+    double      imitation_learning_rate { 0.01 };
+    unsigned    imitation_threads { 1 };
+};
+
+struct experiment_result
+{
+    std::string name;
+    int    generations { 0 };
+    float  best_score  { 0 };      // best score over the whole run
+    float  final_best  { 0 };      // best score of the last generation
+    float  final_mean  { 0 };      // mean score of the last generation
+    unsigned long long evaluations { 0 };
+    unsigned long long ticks       { 0 };
+    unsigned long long pruned      { 0 };
+    unsigned long long early_bred  { 0 }; // generations bred before their last rollout ended
+    unsigned long long cache_hits   { 0 }; // rollouts skipped thanks to the fitness cache
+    unsigned long long cache_misses { 0 };
+    double seconds { 0 };
+    bool   failed  { false }; // the configuration could not run, nothing above is measured
+};
+
+// Reads an ini-like experiment description :
+//
+//   # comment
+//   [lander_wide]
+//   environment    = lander
+//   hidden_neurons = 4, 8, 16
+//   seed           = 1, 2
+//
+// Each section is one experiment; keys holding a comma separated list are
+// swept, a section expands to the cartesian product of all its lists.
+// Returns false and reports on stderr on malformed input.
+bool load_experiments(const std::string& path, std::vector<experiment_config>& experiments);
+
+// <directory>/<experiment name><extension>, empty if directory is.
+std::string output_path(const experiment_config& config, const std::string& directory, const char* extension);
+
+// Sets one key as load_experiments would, false if unknown or malformed.
+bool set_config_key(experiment_config& config, const std::string& key, const std::string& value);
+// Every setting as a key=value string, for set_config_key on the other side of an exec.
+std::vector<std::string> config_arguments(const experiment_config& config);
+
+// Builds an environment by name, nullptr if unknown.
+PlayField* make_field(const std::string& environment, sf::Vector2i size);
+
+// Trains one population (or several islands) headlessly with a fixed time step.
+// A single population publishes its progress to live, if given, after each generation.
+experiment_result run_experiment(const experiment_config& config, stats_slot* live = nullptr);
+
+#endif // EXPERIMENT_HPP
@@ -0,0 +1,90 @@
+/*
+fitness_cache.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "fitness_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+fitness_cache::fitness_cache(size_t capacity)
+    : m_capacity(capacity)
+{
+    m_entries.reserve(capacity);
+}
+
+uint64_t weights_hash(const genann *ann)
+{
+    uint64_t hash = (uint64_t)ann->total_weights;
+    for (int i { 0 }; i < ann->total_weights; ++i)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, ann->weight + i, sizeof(bits));
+        hash = (hash ^ bits) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+bool fitness_cache::lookup(const genann *ann, uint64_t scenario, float &score)
+{
+    auto found = m_entries.find(key(ann, scenario));
+    if (found == m_entries.end() || found->second.scenario != scenario
+            || found->second.weights.size() != (size_t)ann->total_weights
+            || !std::equal(found->second.weights.begin(), found->second.weights.end(), ann->weight))
+    {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    found->second.generation = m_generation;
+    score = found->second.score;
+    return true;
+}
+
+void fitness_cache::store(const genann *ann, uint64_t scenario, float score)
+{
+    if (m_entries.size() >= m_capacity)
+        evict();
+    if (m_entries.size() >= m_capacity)
+        return;
+
+    auto& stored = m_entries[key(ann, scenario)];
+    stored.scenario = scenario;
+    stored.weights.assign(ann->weight, ann->weight + ann->total_weights);
+    stored.score = score;
+    stored.generation = m_generation;
+}
+
+void fitness_cache::evict()
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();)
+    {
+        if (it->second.generation < m_generation)
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
@@ -0,0 +1,80 @@
+/*
+fitness_cache.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef FITNESS_CACHE_HPP
+#define FITNESS_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "genann.h"
+
+// Hash of a net's topology and weights, bit for bit.
+uint64_t weights_hash(const genann* ann);
+
+// Final scores of already evaluated genomes, for environments whose episodes
+// are deterministic : unmutated children, carried over parents and crossovers
+// reproducing a parent then don't have to be flown again. Entries are keyed
+// by a hash of the weights and the scenario they were scored on, and the
+// weights are compared on lookup, so a hash collision is only a miss.
+class fitness_cache
+{
+public:
+    explicit fitness_cache(size_t capacity);
+
+    bool lookup(const genann* ann, uint64_t scenario, float& score);
+    void store(const genann* ann, uint64_t scenario, float score);
+
+    // Entries untouched during the generation that ends become evictable.
+    void end_generation()
+    { ++m_generation; }
+
+    unsigned long long hits() const
+    { return m_hits; }
+    unsigned long long misses() const
+    { return m_misses; }
+
+private:
+    struct entry
+    {
+        uint64_t scenario;
+        std::vector<double> weights;
+        float score;
+        unsigned long long generation; // last use
+    };
+
+    static uint64_t key(const genann* ann, uint64_t scenario)
+    { return weights_hash(ann) ^ scenario * 0x9E3779B97F4A7C15ull; }
+    void evict();
+
+    size_t m_capacity;
+    std::unordered_map<uint64_t, entry> m_entries;
+    unsigned long long m_generation { 0 };
+    unsigned long long m_hits { 0 };
+    unsigned long long m_misses { 0 };
+};
+
+#endif // FITNESS_CACHE_HPP
@@ -168,10 +168,17 @@ genann *genann_copy(genann const *ann) {
 }
 
 
+static genann_randfun random_source = NULL;
+
+void genann_set_random(genann_randfun fn) {
+    random_source = fn;
+}
+
+
 void genann_randomize(genann *ann) {
     int i;
     for (i = 0; i < ann->total_weights; ++i) {
-        double r = GENANN_RANDOM();
+        double r = random_source ? random_source() : GENANN_RANDOM();
         /* Sets weights from -0.5 to 0.5. */
         ann->weight[i] = r - 0.5;
     }
@@ -262,6 +269,93 @@ double const *genann_run(genann const *ann, double const *inputs) {
 }
 
 
+/* Derivatives of the activations, from their output. */
+static double genann_act_hidden_derivative(double o) {
+    return o > 0 ? 1 : o + 1; /* ELU */
+}
+
+static double genann_act_output_derivative(double o) {
+    return o * (1 - o); /* sigmoid */
+}
+
+
+/* Fills ann->delta for the squared error against desired_outputs, after a genann_run. */
+static void genann_deltas(genann const *ann, double const *desired_outputs) {
+    int h, j, k;
+
+    /* Output layer deltas. */
+    {
+        double const *o = ann->output + ann->inputs + ann->hidden * ann->hidden_layers;
+        double *d = ann->delta + ann->hidden * ann->hidden_layers;
+        double const *t = desired_outputs;
+
+        for (j = 0; j < ann->outputs; ++j) {
+            *d++ = (*t - *o) * genann_act_output_derivative(*o);
+            ++o; ++t;
+        }
+    }
+
+    /* Hidden layer deltas, from the last one back. */
+    for (h = ann->hidden_layers - 1; h >= 0; --h) {
+        double const *o = ann->output + ann->inputs + (h * ann->hidden);
+        double *d = ann->delta + (h * ann->hidden);
+
+        /* The deltas and weights of the layer after this one. */
+        double const *const dd = ann->delta + ((h+1) * ann->hidden);
+        double const *const ww = ann->weight + ((ann->inputs+1) * ann->hidden) + ((ann->hidden+1) * ann->hidden * h);
+        const int next_count = h == ann->hidden_layers - 1 ? ann->outputs : ann->hidden;
+
+        for (j = 0; j < ann->hidden; ++j) {
+            double delta = 0;
+            for (k = 0; k < next_count; ++k) {
+                delta += dd[k] * ww[k * (ann->hidden + 1) + (j + 1)];
+            }
+            *d++ = genann_act_hidden_derivative(*o++) * delta;
+        }
+    }
+}
+
+
+/* Adds scale * delta * input to target, laid out like ann->weight. */
+static void genann_accumulate(genann const *ann, double scale, double *target) {
+    int h, j, k;
+    double *w = target;
+
+    for (h = 0; h <= ann->hidden_layers; ++h) {
+        /* Inputs of this layer, its deltas and its size. */
+        double const *i = h == 0 ? ann->output : ann->output + ann->inputs + (h-1) * ann->hidden;
+        double const *d = ann->delta + h * ann->hidden;
+        const int input_count = h == 0 ? ann->inputs : ann->hidden;
+        const int count = h == ann->hidden_layers ? ann->outputs : ann->hidden;
+
+        for (j = 0; j < count; ++j) {
+            const double step = scale * d[j];
+            *w++ += step * -1.0;
+            for (k = 0; k < input_count; ++k) {
+                w[k] += step * i[k];
+            }
+            w += input_count;
+        }
+    }
+
+    assert(w - target == ann->total_weights);
+}
+
+
+void genann_train(genann const *ann, double const *inputs, double const *desired_outputs, double learning_rate) {
+    genann_run(ann, inputs);
+    genann_deltas(ann, desired_outputs);
+    genann_accumulate(ann, learning_rate, ann->weight);
+}
+
+
+void genann_backprop(genann const *ann, double const *inputs, double const *desired_outputs, double *accumulator) {
+    genann_run(ann, inputs);
+    genann_deltas(ann, desired_outputs);
+    genann_accumulate(ann, 1.0, accumulator);
+}
+
+
 void genann_write(genann const *ann, FILE *out) {
     fprintf(out, "%d %d %d %d", ann->inputs, ann->hidden_layers, ann->hidden, ann->outputs);
 
@@ -43,6 +43,9 @@ struct genann;
 
 typedef double (*genann_actfun)(const struct genann *ann, double a);
 
+/* Uniform random number in [0; 1]. */
+typedef double (*genann_randfun)(void);
+
 typedef struct genann {
     /* How many inputs, outputs, and hidden neurons. */
     int inputs, hidden_layers, hidden, outputs;
@@ -80,6 +83,9 @@ genann *genann_read(FILE *in);
 /* Sets weights randomly. Called by init. */
 void genann_randomize(genann *ann);
 
+/* Replaces GENANN_RANDOM as the source used by genann_randomize, NULL restores it. */
+void genann_set_random(genann_randfun fn);
+
 /* Returns a new copy of ann. */
 genann *genann_copy(genann const *ann);
 
@@ -92,6 +98,12 @@ double const *genann_run(genann const *ann, double const *inputs);
 /* Does a single backprop update. */
 void genann_train(genann const *ann, double const *inputs, double const *desired_outputs, double learning_rate);
 
+/* Runs ann on inputs and adds to accumulator (total_weights long) the update
+ * genann_train would apply with a learning rate of 1, without touching the
+ * weights. Summing it over a minibatch gives the batch's descent direction;
+ * only ann's scratch buffers are written, so each thread needs its own copy. */
+void genann_backprop(genann const *ann, double const *inputs, double const *desired_outputs, double *accumulator);
+
 /* Saves the ann. */
 void genann_write(genann const *ann, FILE *out);
 
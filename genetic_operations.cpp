@@ -31,8 +31,11 @@ SOFTWARE.
 #include <cmath>
 
 #include <functional>
+#include <algorithm>
 
 #include "playfield.hpp"
+#include "random.hpp"
+#include "sparse_net.hpp"
 
 #include "genann.h"
 
@@ -49,8 +52,8 @@ neural_net crossover(const neural_net &parent_1, const neural_net &parent_2)
 #if 0
     assert(parent_1.nn->total_weights == parent_2.nn->total_weights);
 
-    int split_point_1 = rand() % parent_1.nn->total_weights;
-    int split_point_2 = rand() % parent_1.nn->total_weights;
+    int split_point_1 = random_int(parent_1.nn->total_weights);
+    int split_point_2 = random_int(parent_1.nn->total_weights);
 
     // split point are ][
     int lower_split_point = min(split_point_1, split_point_2);
@@ -72,52 +75,101 @@ neural_net crossover(const neural_net &parent_1, const neural_net &parent_2)
     // randomly choose the genes of one of the parents
     for (size_t i { 0 }; i < new_net.nn->total_weights; ++i)
     {
-        if (rand() % 2)
+        if (random_int(2))
             new_net.nn->weight[i] = parent_1.nn->weight[i];
         else
             new_net.nn->weight[i] = parent_2.nn->weight[i];
     }
+    // self-adaptive gaussian steps are recombined too, see mutate_gaussian()
+    if (parent_1.mutation_step > 0 && parent_2.mutation_step > 0)
+        new_net.mutation_step = std::sqrt(parent_1.mutation_step * parent_2.mutation_step);
+    else
+        new_net.mutation_step = max(parent_1.mutation_step, parent_2.mutation_step);
 
     return new_net;
 #endif
 }
 
-neural_net mutate(const neural_net &net, double mutation_factor)
+neural_net mutate(const neural_net &net, double mutation_factor, int genes)
 {
-#if 1
-    double mutation_probabiblity = 0.1;
+    double mutation_probabiblity = mutation_factor;
 
     // no mutation
-    if ((double)rand() / RAND_MAX < mutation_probabiblity)
+    if (random_unit() < mutation_probabiblity)
         return net;
 
-    int mutated_gene = rand() % net.nn->total_weights;
-
     neural_net mutated = net;
-    mutated.nn->weight[mutated_gene] = (double)rand() / RAND_MAX - 0.5;
+    // a zero weight is a pruned connection, left to add_connection() : the
+    // values are drawn all the same so that pruning keeps the random sequence
+    for (int i { 0 }; i < genes; ++i)
+    {
+        int mutated_gene = random_int(net.nn->total_weights);
+        double value = random_unit() - 0.5;
+        if (mutated.nn->weight[mutated_gene] != 0)
+            mutated.nn->weight[mutated_gene] = value;
+    }
 
     return mutated;
-#else
-    double mutation_probabiblity = 1.0/net.nn->total_weights;
+}
 
-    neural_net mutated = net;
+namespace
+{
 
-    for (size_t i { 0 }; i < net.nn->total_weights; ++i)
+// Index of the n-th weight of ann that is zero or not, as asked.
+int nth_weight(const genann* ann, bool zero, int n)
+{
+    for (int i { 0 }; i < ann->total_weights; ++i)
     {
-        if ((double)rand() / RAND_MAX <= mutation_probabiblity)
-            mutated.nn->weight[i] += 1.0 - 2*((double)rand() / RAND_MAX);
+        if ((ann->weight[i] == 0.0) == zero && n-- == 0)
+            return i;
     }
+    return -1;
+}
+
+}
+
+neural_net remove_connection(const neural_net &net)
+{
+    int connections = (int)connection_count(net.nn);
+    if (connections == 0)
+        return net;
+
+    neural_net mutated = net;
+    mutated.nn->weight[nth_weight(net.nn, false, random_int(connections))] = 0.0;
+
+    return mutated;
+}
+
+neural_net add_connection(const neural_net &net)
+{
+    int missing = net.nn->total_weights - (int)connection_count(net.nn);
+    if (missing == 0)
+        return net;
+
+    neural_net mutated = net;
+    mutated.nn->weight[nth_weight(net.nn, true, random_int(missing))] = random_unit() - 0.5;
+
+    return mutated;
+}
+
+neural_net mutate_topology(const neural_net &net, double removal_rate, double addition_rate)
+{
+    // no draw at a zero rate, dense runs keep their random sequence
+    neural_net mutated = net;
+    if (removal_rate > 0 && random_unit() < removal_rate)
+        mutated = remove_connection(mutated);
+    if (addition_rate > 0 && random_unit() < addition_rate)
+        mutated = add_connection(mutated);
 
     return mutated;
-#endif
 }
 
-std::vector<neural_net> breed(const neural_net &parent_1, const neural_net &parent_2, size_t children_count)
+std::vector<neural_net> breed(const neural_net &parent_1, const neural_net &parent_2, size_t children_count, double mutation_factor, int genes)
 {
     std::vector<neural_net> offspring;
 
     for (size_t i { 0 }; i < children_count; ++i)
-        offspring.push_back(mutate(crossover(parent_1, parent_2)));
+        offspring.push_back(mutate(crossover(parent_1, parent_2), mutation_factor, genes));
 
     return offspring;
 }
@@ -153,7 +205,7 @@ std::vector<const PlayField *> select(const std::vector<const PlayField *> &fiel
             normalized_fitnesses[i] += normalized_fitnesses[i-1];
         }
 
-        double random_selector = (double)rand() / RAND_MAX;
+        double random_selector = random_unit();
 
         for (size_t i { 0 }; i < normalized_fitnesses.size(); ++i)
         {
@@ -27,14 +27,26 @@ SOFTWARE.
 
 #include "network.hpp"
 #include <vector>
+#include <cstddef>
 
 class PlayField;
 
 neural_net crossover(const neural_net& parent_1, const neural_net& parent_2);
-neural_net mutate(const neural_net& net, double mutation_factor = 0.1);
+// Replaces `genes` random weights (drawn with replacement) unless skipped,
+// with a probability of mutation_factor. Zero weights, missing connections,
+// are drawn but left as they are.
+neural_net mutate(const neural_net& net, double mutation_factor = 0.1, int genes = 1);
+
+// Topology mutations, a zero weight being a missing connection (see sparse_net) :
+// remove_connection zeroes a random nonzero weight, add_connection gives a
+// random zero weight a new value. Both change net in place, like mutate().
+neural_net remove_connection(const neural_net& net);
+neural_net add_connection(const neural_net& net);
+// Applies each of them with its own probability.
+neural_net mutate_topology(const neural_net& net, double removal_rate, double addition_rate);
 
 std::vector<const PlayField*> select(const std::vector<const PlayField*>& fields, size_t amount_to_select);
 
-std::vector<neural_net> breed(const neural_net& parent_1, const neural_net& parent_2, size_t children_count);
+std::vector<neural_net> breed(const neural_net& parent_1, const neural_net& parent_2, size_t children_count, double mutation_factor = 0.1, int genes = 1);
 
 #endif // GENETIC_OPERATIONS_HPP
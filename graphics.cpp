@@ -1,16 +1,24 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
+#include <chrono>
 #include <cmath>
 #include <ctime>
 #include <cstdlib>
 #include <cassert>
+#include <limits>
 #include <memory>
+#include <string>
 
 #include "network.hpp"
 #include "common.hpp"
 #include "genetic_operations.hpp"
+#include "trainer.hpp"
+#include "random.hpp"
 #include "pong.hpp"
 #include "lander.hpp"
+#include "trajectory.hpp"
+#include "capture.hpp"
+#include "stats_server.hpp"
 
 sf::Color paddle_colors[6] =
 {
@@ -25,8 +33,220 @@ sf::Color paddle_colors[6] =
 const size_t fields_column_count = 5;
 const size_t fields_line_count   = 4;
 
-int main()
+void layout_fields(std::vector<PlayField*>& fields)
 {
+    for (size_t i { 0 }; i < fields_column_count; ++i)
+    {
+        for (size_t j { 0 }; j < fields_line_count; ++j)
+        {
+            fields[j + i*fields_line_count]->move((float)i*gameWidth/fields_column_count, (float)j*gameHeight/fields_line_count);
+            fields[j + i*fields_line_count]->setScale(1.f/fields_column_count, 1.f/fields_line_count);
+        }
+    }
+}
+
+// Where --capture sends the replay, instead of a window.
+struct capture_options
+{
+    std::string output;   // a .y4m video or a directory for a png sequence
+    unsigned width  { windowWidth };
+    unsigned height { windowHeight };
+    unsigned fps    { 60 };
+    float    speed  { 1 };
+};
+
+// Plays back a trajectory log, a page of episodes at a time :
+// space pauses, left/right seek by a second, up/down change the speed,
+// page up/down switch pages.
+//
+// With a capture output, every page is rendered offscreen instead, one frame
+// each 1/fps seconds of (sped up) replay time until its longest flight ends.
+// No window is opened : it runs headless, on a virtual framebuffer
+// (xvfb-run) if there is no display at all.
+int replay(const char* path, const capture_options& capture)
+{
+    trajectory_player player;
+    if (!player.open(path) || player.episodes().empty())
+        return EXIT_FAILURE;
+
+    sf::Font font;
+    if (!font.loadFromFile("resources/sansation.ttf"))
+        return EXIT_FAILURE;
+
+    std::vector<PlayField*> fields;
+    for (size_t i { 0 }; i < fields_column_count*fields_line_count; ++i)
+        fields.emplace_back(new LanderPlayField(sf::Vector2i{gameWidth, gameHeight}));
+    layout_fields(fields);
+
+    sf::Text status;
+    status.setFont(font);
+    status.setCharacterSize(40);
+    status.setPosition(20.f, gameHeight);
+    status.setFillColor(sf::Color::White);
+
+    std::vector<std::vector<lander_state>> flights(fields.size());
+    size_t page = 0;
+    size_t page_count = (player.episodes().size() + fields.size() - 1) / fields.size();
+    float time  = 0;
+    float speed = capture.speed;
+    bool  paused = false;
+
+    auto load_page = [&]
+    {
+        for (size_t i { 0 }; i < fields.size(); ++i)
+        {
+            size_t episode = page*fields.size() + i;
+            flights[i].clear();
+            if (episode < player.episodes().size())
+                player.load(episode, flights[i]);
+            fields[i]->set_playing(!flights[i].empty());
+        }
+        time = 0;
+    };
+    load_page();
+
+    auto draw = [&](sf::RenderTarget& target)
+    {
+        target.clear(sf::Color(50, 200, 50));
+        for (size_t i { 0 }; i < fields.size(); ++i)
+        {
+            if (flights[i].empty())
+                continue;
+
+            const auto& info = player.episodes()[page*fields.size() + i];
+            size_t tick = std::min<size_t>(time / info.time_step, flights[i].size() - 1);
+            static_cast<LanderPlayField*>(fields[i])->set_state(flights[i][tick], tick * info.time_step);
+            target.draw(*fields[i]);
+        }
+
+        const auto& first = player.episodes()[page*fields.size()];
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "Generation %u  -  page %zu/%zu  -  t = %.2fs  x%.2f%s",
+                 first.generation, page + 1, page_count, time, speed, paused ? "  (paused)" : "");
+        status.setString(buffer);
+        target.draw(status);
+    };
+
+    if (!capture.output.empty())
+    {
+        sf::RenderTexture texture;
+        frame_capture frames;
+        if (!frames.open(capture.output, capture.width, capture.height, capture.fps) ||
+                !texture.create(frames.width(), frames.height()))
+            return EXIT_FAILURE;
+        texture.setView(sf::View(sf::FloatRect(0, 0, windowWidth, windowHeight)));
+
+        for (page = 0; page < page_count; ++page)
+        {
+            load_page();
+            float duration = 0;
+            for (size_t i { 0 }; i < fields.size(); ++i)
+            {
+                if (!flights[i].empty())
+                    duration = std::max(duration, flights[i].size() * player.episodes()[page*fields.size() + i].time_step);
+            }
+
+            for (unsigned long long frame { 0 }; time <= duration; time = ++frame * speed / capture.fps)
+            {
+                draw(texture);
+                texture.display();
+                frames.capture(texture);
+            }
+        }
+        frames.close();
+        fprintf(stderr, "%s: %llu frames\n", capture.output.c_str(), frames.frames() - frames.dropped());
+
+        return EXIT_SUCCESS;
+    }
+
+    sf::RenderWindow window(sf::VideoMode(windowWidth, windowHeight, 32), "Replay",
+                            sf::Style::Titlebar | sf::Style::Close);
+    window.setVerticalSyncEnabled(true);
+
+    sf::Clock clock;
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if ((event.type == sf::Event::Closed) ||
+                    ((event.type == sf::Event::KeyPressed) && (event.key.code == sf::Keyboard::Escape)))
+            {
+                window.close();
+                break;
+            }
+            if (event.type != sf::Event::KeyPressed)
+                continue;
+
+            switch (event.key.code)
+            {
+                case sf::Keyboard::Space:    paused = !paused; break;
+                case sf::Keyboard::Left:     time = std::max(0.f, time - 1.f); break;
+                case sf::Keyboard::Right:    time += 1.f; break;
+                case sf::Keyboard::Up:       speed *= 2; break;
+                case sf::Keyboard::Down:     speed /= 2; break;
+                case sf::Keyboard::PageUp:   page = (page + page_count - 1) % page_count; load_page(); break;
+                case sf::Keyboard::PageDown: page = (page + 1) % page_count; load_page(); break;
+                default: break;
+            }
+        }
+
+        if (!paused)
+            time += clock.getElapsedTime().asSeconds() * speed;
+        clock.restart();
+
+        draw(window);
+        window.display();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 3 && std::string(argv[1]) == "--replay")
+    {
+        // --replay <log> [--capture <out.y4m | directory>] [--size WxH] [--fps N] [--speed x]
+        capture_options capture;
+        bool valid = (argc - 3) % 2 == 0;
+        for (int i { 3 }; valid && i + 1 < argc; i += 2)
+        {
+            std::string option = argv[i];
+            if (option == "--capture")
+                capture.output = argv[i+1];
+            else if (option == "--size")
+                valid = sscanf(argv[i+1], "%ux%u", &capture.width, &capture.height) == 2;
+            else if (option == "--fps")
+                capture.fps = (unsigned)std::atoi(argv[i+1]);
+            else if (option == "--speed")
+            {
+                // a capture only moves forward in replay time
+                capture.speed = (float)std::atof(argv[i+1]);
+                valid = capture.speed > 0;
+            }
+            else
+                valid = false;
+        }
+        if (!valid)
+        {
+            fprintf(stderr, "usage: %s --replay <log> [--capture <out.y4m | directory>] [--size WxH] [--fps N] [--speed x]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        return replay(argv[2], capture);
+    }
+
+    // --stats-port <port> serves the progress on localhost, see stats_server.hpp
+    std::unique_ptr<stats_board> board;
+    stats_server server;
+    if (argc == 3 && std::string(argv[1]) == "--stats-port")
+    {
+        board.reset(new stats_board({ "visualizer" }, 1));
+        if (!server.start(*board, (unsigned short)std::atoi(argv[2])))
+            return EXIT_FAILURE;
+    }
+    live_stats progress;
+    auto generation_start = std::chrono::steady_clock::now();
+
     int generation = 0;
 
     int field_width  = gameWidth;
@@ -62,14 +282,7 @@ int main()
         fields.emplace_back(new LanderPlayField(sf::Vector2i{field_width, field_height}));
     }
 
-    for (size_t i { 0 }; i < fields_column_count; ++i)
-    {
-        for (size_t j { 0 }; j < fields_line_count; ++j)
-        {
-            fields[j + i*fields_line_count]->move((float)i*field_width/fields_column_count, (float)j*field_height/fields_line_count);
-            fields[j + i*fields_line_count]->setScale(1.f/fields_column_count, 1.f/fields_line_count);
-        }
-    }
+    layout_fields(fields);
 
     //    fields[0]->move(0, 0);
     //    fields[1]->move(0, field_height);
@@ -78,7 +291,7 @@ int main()
     //    fields[4]->move(field_width, field_height);
     //    fields[5]->move(field_width, field_height*2);
 
-    std::srand(static_cast<unsigned int>(std::time(nullptr)));
+    seed_random(static_cast<unsigned int>(std::time(nullptr)));
 
     // Create the window of the application
     sf::RenderWindow window(sf::VideoMode(windowWidth, windowHeight, 32), "SFML Pong",
@@ -100,6 +313,8 @@ int main()
 
     bool space_pressed = false;
 
+    generation_pipeline pipeline(ga_params{});
+
     sf::Clock clock;
 
     while (window.isOpen())
@@ -138,34 +353,43 @@ int main()
 
             genMessage.setString(L"Génération : " + std::to_wstring(generation));
 
-            std::vector<const PlayField*> field_ptrs;
-            field_ptrs.reserve(fields.size());
-            for (const auto* field : fields)
-                field_ptrs.emplace_back(field);
-
-            std::sort(field_ptrs.begin(), field_ptrs.end(), [](const PlayField* lhs, const PlayField* rhs)
-            { return lhs->score() > rhs->score(); });
-
-            //field_ptrs = select(field_ptrs, 2);
-
-            auto offspring = breed(field_ptrs[0]->net, field_ptrs[1]->net, fields.size()); // the parents
-
-            for (size_t i { 0 }; i < fields.size(); ++i)
+            // the first generation starts from nets that never flew
+            const bool evaluated = board && generation > 1;
+            if (evaluated)
             {
-                auto* field = fields[i];
-
-                field->reset();
-                // (re)start the game
-                field->set_playing(true);
-                clock.restart();
+                progress.state      = live_stats::running;
+                progress.generation = generation - 2;
+                progress.final_best = -std::numeric_limits<double>::infinity();
+                progress.final_mean = 0;
+                for (const auto* field : fields)
+                {
+                    progress.final_best  = std::max<double>(progress.final_best, field->score());
+                    progress.final_mean += field->score() / fields.size();
+                }
+                progress.best_score   = progress.generation ? std::max(progress.best_score, progress.final_best) : progress.final_best;
+                progress.evaluations += fields.size();
             }
 
-            // replace the nets but the 3 last with the offspring
-            for (size_t i { 0 }; i < fields.size()-3; ++i)
+            // the clock is only read for the stats server
+            std::chrono::steady_clock::time_point breeding;
+            if (board)
+                breeding = std::chrono::steady_clock::now();
+            pipeline.advance(fields);
+            clock.restart();
+
+            if (evaluated)
             {
-                fields[i]->net = offspring[i];
+                auto now = std::chrono::steady_clock::now();
+                progress.seconds          = std::chrono::duration<double>(now - board->start()).count();
+                progress.evaluate_seconds = std::chrono::duration<double>(breeding - generation_start).count();
+                progress.breed_seconds    = std::chrono::duration<double>(now - breeding).count();
+                board->slot(0).publish(progress);
             }
+            if (board)
+                generation_start = std::chrono::steady_clock::now();
         }
+        else
+            pipeline.update(fields);
 
         for (size_t i { 0 }; i < fields.size(); ++i)
         {
@@ -0,0 +1,308 @@
+/*
+headless.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+// Headless entry point : trains without opening a window.
+//
+//   NeuralNetworkTrainer sweep <experiments.ini> [-j threads] [--no-pin] [-o summary.csv] [--stats-port port]
+//   NeuralNetworkTrainer export <champion.net> <out.hpp> [--name policy] [--check check.cpp]
+//   NeuralNetworkTrainer scenarios <out.bank> [--environment lander|pong] [--count n] [--seed s] [--terrain roughness]
+//   NeuralNetworkTrainer lineage <run.lineage> [--genome id | --best] [--ancestry] [-o out.net]
+//
+// --ancestry follows nearest ancestors (see lineage_writer), a guess at the
+// parents rather than a record of the breeding, up to a genome stored whole.
+//
+// island-worker is started by the sweep itself when island_processes is set.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "experiment.hpp"
+#include "sweep.hpp"
+#include "codegen.hpp"
+#include "island_process.hpp"
+#include "scenario_bank.hpp"
+#include "lineage.hpp"
+
+#include "genann.h"
+
+namespace
+{
+
+int usage()
+{
+    fprintf(stderr, "usage: NeuralNetworkTrainer sweep <experiments.ini> [-j threads] [--no-pin] [-o summary.csv] [--stats-port port]\n"
+                    "       NeuralNetworkTrainer export <champion.net> <out.hpp> [--name policy] [--check check.cpp]\n"
+                    "       NeuralNetworkTrainer scenarios <out.bank> [--environment lander|pong] [--count n] [--seed s] [--terrain roughness]\n"
+                    "       NeuralNetworkTrainer lineage <run.lineage> [--genome id | --best] [--ancestry] [-o out.net]\n"
+                    "         --ancestry : nearest ancestors, the closest genome of each previous generation (a guess, not the parents)\n");
+    return EXIT_FAILURE;
+}
+
+int sweep_main(int argc, char** argv)
+{
+    std::string config_path;
+    std::string summary_path;
+    sweep_options options;
+
+    for (int i { 0 }; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-j") && i+1 < argc)
+            options.threads = (unsigned)std::atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i+1 < argc)
+            summary_path = argv[++i];
+        else if (!strcmp(argv[i], "--no-pin"))
+            options.pin = false;
+        else if (!strcmp(argv[i], "--stats-port") && i+1 < argc)
+            options.stats_port = (unsigned short)std::atoi(argv[++i]);
+        else if (config_path.empty())
+            config_path = argv[i];
+        else
+            return usage();
+    }
+
+    if (config_path.empty())
+        return usage();
+
+    std::vector<experiment_config> experiments;
+    if (!load_experiments(config_path, experiments))
+        return EXIT_FAILURE;
+
+    auto results = run_sweep(experiments, options);
+
+    FILE* out = stdout;
+    if (!summary_path.empty() && !(out = fopen(summary_path.c_str(), "w")))
+    {
+        perror(summary_path.c_str());
+        return EXIT_FAILURE;
+    }
+    write_summary(out, results);
+    if (out != stdout)
+        fclose(out);
+
+    // the summary still lists them, with nothing measured
+    bool failed = std::any_of(results.begin(), results.end(), [](const experiment_result& result) { return result.failed; });
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int export_main(int argc, char** argv)
+{
+    std::string genome_path, header_path, check_path;
+    std::string name = "policy";
+
+    for (int i { 0 }; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--name") && i+1 < argc)
+            name = argv[++i];
+        else if (!strcmp(argv[i], "--check") && i+1 < argc)
+            check_path = argv[++i];
+        else if (genome_path.empty())
+            genome_path = argv[i];
+        else if (header_path.empty())
+            header_path = argv[i];
+        else
+            return usage();
+    }
+
+    if (header_path.empty())
+        return usage();
+
+    FILE* in = fopen(genome_path.c_str(), "r");
+    if (!in)
+    {
+        perror(genome_path.c_str());
+        return EXIT_FAILURE;
+    }
+    genann* ann = genann_read(in);
+    fclose(in);
+    if (!ann)
+        return EXIT_FAILURE;
+
+    FILE* out = fopen(header_path.c_str(), "w");
+    if (!out)
+    {
+        perror(header_path.c_str());
+        genann_free(ann);
+        return EXIT_FAILURE;
+    }
+    write_network_header(ann, out, name);
+    fclose(out);
+
+    if (!check_path.empty())
+    {
+        if (!(out = fopen(check_path.c_str(), "w")))
+        {
+            perror(check_path.c_str());
+            genann_free(ann);
+            return EXIT_FAILURE;
+        }
+        write_network_check(ann, out, name, header_path, genome_path);
+        fclose(out);
+    }
+
+    genann_free(ann);
+
+    return EXIT_SUCCESS;
+}
+
+int scenarios_main(int argc, char** argv)
+{
+    std::string bank_path;
+    scenario_bank_options options;
+
+    for (int i { 0 }; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--environment") && i+1 < argc)
+            options.environment = argv[++i];
+        else if (!strcmp(argv[i], "--count") && i+1 < argc)
+            options.count = std::strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--seed") && i+1 < argc)
+            options.seed = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--terrain") && i+1 < argc)
+        {
+            options.terrain = true;
+            options.terrain_roughness = (float)std::atof(argv[++i]);
+        }
+        else if (bank_path.empty())
+            bank_path = argv[i];
+        else
+            return usage();
+    }
+
+    if (bank_path.empty())
+        return usage();
+
+    return write_scenario_bank(bank_path, options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Without a genome, a summary of the store ; with one, its ancestry and/or the net itself.
+int lineage_main(int argc, char** argv)
+{
+    std::string store_path, net_path;
+    uint64_t id = no_ancestor;
+    bool best = false, ancestry = false;
+
+    for (int i { 0 }; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--genome") && i+1 < argc)
+            id = std::strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--best"))
+            best = true;
+        else if (!strcmp(argv[i], "--ancestry"))
+            ancestry = true;
+        else if (!strcmp(argv[i], "-o") && i+1 < argc)
+            net_path = argv[++i];
+        else if (store_path.empty())
+            store_path = argv[i];
+        else
+            return usage();
+    }
+
+    if (store_path.empty())
+        return usage();
+
+    lineage_reader store;
+    if (!store.open(store_path) || !store.size())
+        return EXIT_FAILURE;
+
+    if (best)
+    {
+        id = 0;
+        for (uint64_t i { 1 }; i < store.size(); ++i)
+        {
+            if (store[i].score > store[id].score)
+                id = i;
+        }
+    }
+
+    if (id == no_ancestor)
+    {
+        printf("%zu genomes over %d generations\n", store.size(), store[store.size() - 1].generation + 1);
+        return EXIT_SUCCESS;
+    }
+    if (id >= store.size())
+    {
+        fprintf(stderr, "%s: no genome %llu\n", store_path.c_str(), (unsigned long long)id);
+        return EXIT_FAILURE;
+    }
+
+    for (uint64_t genome { id }; genome != no_ancestor;)
+    {
+        uint64_t ancestor;
+        uint32_t field;
+        if (!store.header(genome, ancestor, field))
+        {
+            fprintf(stderr, "%s: genome %llu is damaged\n", store_path.c_str(), (unsigned long long)genome);
+            return EXIT_FAILURE;
+        }
+        printf("genome %llu : generation %d, field %u, score %.3f\n", (unsigned long long)genome,
+               store[genome].generation, field, store[genome].score);
+        genome = ancestry ? ancestor : no_ancestor;
+    }
+
+    if (!net_path.empty())
+    {
+        genann* ann = store.load(id);
+        FILE* out = ann ? fopen(net_path.c_str(), "w") : nullptr;
+        if (!out)
+        {
+            if (ann)
+                perror(net_path.c_str());
+            else
+                fprintf(stderr, "%s: can't rebuild genome %llu\n", store_path.c_str(), (unsigned long long)id);
+            genann_free(ann);
+            return EXIT_FAILURE;
+        }
+        genann_write(ann, out);
+        fclose(out);
+        genann_free(ann);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        return usage();
+
+    if (!strcmp(argv[1], "sweep"))
+        return sweep_main(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "export"))
+        return export_main(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "scenarios"))
+        return scenarios_main(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "lineage"))
+        return lineage_main(argc - 2, argv + 2);
+    if (!strcmp(argv[1], "island-worker"))
+        return island_worker_main(argc - 2, argv + 2);
+
+    return usage();
+}
@@ -0,0 +1,213 @@
+/*
+imitation.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "imitation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include "common.hpp"
+#include "lander.hpp"
+#include "random.hpp"
+#include "shard_pool.hpp"
+#include "trajectory.hpp"
+
+namespace
+{
+
+// Per input mean and spread of the samples.
+void input_statistics(const training_set& set, std::vector<double>& mean, std::vector<double>& spread)
+{
+    const size_t count = set.size();
+    mean.assign(set.inputs, 0.0);
+    spread.assign(set.inputs, 0.0);
+    for (size_t i { 0 }; i < count; ++i)
+    {
+        for (int k { 0 }; k < set.inputs; ++k)
+            mean[k] += set.x[i * set.inputs + k] / count;
+    }
+    for (size_t i { 0 }; i < count; ++i)
+    {
+        for (int k { 0 }; k < set.inputs; ++k)
+        {
+            double deviation = set.x[i * set.inputs + k] - mean[k];
+            spread[k] += deviation * deviation / count;
+        }
+    }
+    for (auto& value : spread)
+        value = value > 1e-12 ? std::sqrt(value) : 1.0;
+}
+
+// First layer rewritten between raw inputs x and standardized ones (x - mean) / spread.
+void standardize_first_layer(genann* ann, const std::vector<double>& mean, const std::vector<double>& spread, bool to_standard)
+{
+    for (int j { 0 }; j < ann->hidden; ++j)
+    {
+        double* row = ann->weight + j * (ann->inputs + 1); // bias first
+        for (int k { 0 }; k < ann->inputs; ++k)
+        {
+            if (to_standard)
+            {
+                row[0] -= row[k + 1] * mean[k];
+                row[k + 1] *= spread[k];
+            }
+            else
+            {
+                row[k + 1] /= spread[k];
+                row[0] += row[k + 1] * mean[k];
+            }
+        }
+    }
+}
+
+}
+
+double train_network(genann *ann, const training_set &set, const backprop_params &params)
+{
+    const size_t sample_count = set.size();
+    if (!sample_count || set.inputs != ann->inputs || set.outputs != ann->outputs)
+        return 0;
+
+    const size_t batch_size = std::max<size_t>(params.batch_size, 1);
+    const unsigned thread_count = std::max(1u, std::min<unsigned>(params.threads, batch_size));
+    const int weight_count = ann->total_weights;
+
+    std::vector<double> mean, spread;
+    input_statistics(set, mean, spread);
+    std::vector<double> inputs(set.x.size());
+    for (size_t i { 0 }; i < sample_count; ++i)
+    {
+        for (int k { 0 }; k < set.inputs; ++k)
+            inputs[i * set.inputs + k] = (set.x[i * set.inputs + k] - mean[k]) / spread[k];
+    }
+
+    if (params.fresh_start)
+        genann_randomize(ann);
+    else
+        standardize_first_layer(ann, mean, spread, true);
+
+    // every thread works on its own copy, genann_run writes into the net
+    std::vector<genann*> replicas(thread_count);
+    std::vector<std::vector<double>> accumulators(thread_count, std::vector<double>(weight_count));
+    std::vector<double> errors(thread_count);
+    for (auto& replica : replicas)
+        replica = genann_copy(ann);
+
+    std::vector<size_t> order(sample_count);
+    for (size_t i { 0 }; i < sample_count; ++i)
+        order[i] = i;
+
+    size_t batch_begin = 0, batch_end = 0;
+    auto backprop_shard = [&](unsigned shard)
+    {
+        genann* replica = replicas[shard];
+        std::memcpy(replica->weight, ann->weight, sizeof(double) * weight_count);
+        std::fill(accumulators[shard].begin(), accumulators[shard].end(), 0.0);
+
+        const size_t length = batch_end - batch_begin;
+        const size_t begin = batch_begin + length * shard / thread_count;
+        const size_t end   = batch_begin + length * (shard + 1) / thread_count;
+        const double* output = replica->output + replica->total_neurons - replica->outputs;
+        for (size_t i { begin }; i < end; ++i)
+        {
+            const double* target = &set.y[order[i] * set.outputs];
+            genann_backprop(replica, &inputs[order[i] * set.inputs], target, accumulators[shard].data());
+            for (int j { 0 }; j < set.outputs; ++j)
+                errors[shard] += (target[j] - output[j]) * (target[j] - output[j]);
+        }
+    };
+
+    double mean_error = 0;
+    {
+        shard_pool pool(thread_count);
+        for (int epoch { 0 }; epoch < params.epochs; ++epoch)
+        {
+            std::shuffle(order.begin(), order.end(), random_engine());
+            std::fill(errors.begin(), errors.end(), 0.0);
+
+            for (batch_begin = 0; batch_begin < sample_count; batch_begin = batch_end)
+            {
+                batch_end = std::min(batch_begin + batch_size, sample_count);
+                pool.run(backprop_shard);
+
+                for (unsigned shard { 1 }; shard < thread_count; ++shard)
+                {
+                    for (int j { 0 }; j < weight_count; ++j)
+                        accumulators[0][j] += accumulators[shard][j];
+                }
+                const double step = params.learning_rate / (batch_end - batch_begin);
+                for (int j { 0 }; j < weight_count; ++j)
+                    ann->weight[j] += step * accumulators[0][j];
+            }
+
+            double total = 0;
+            for (double error : errors)
+                total += error;
+            mean_error = total / (sample_count * set.outputs);
+        }
+    }
+
+    for (auto* replica : replicas)
+        genann_free(replica);
+
+    standardize_first_layer(ann, mean, spread, false);
+
+    return mean_error;
+}
+
+bool load_demonstrations(const std::string &path, float min_score, training_set &set)
+{
+    trajectory_player player;
+    if (!player.open(path))
+        return false;
+
+    // the landing pad position, for observe()
+    LanderPlayField observer(sf::Vector2i{gameWidth, gameHeight});
+
+    set.inputs  = LanderPlayField::input_count;
+    set.outputs = LanderPlayField::output_count;
+
+    double inputs[LanderPlayField::input_count];
+    double outputs[LanderPlayField::output_count];
+    std::vector<lander_state> states;
+    for (size_t episode { 0 }; episode < player.episodes().size(); ++episode)
+    {
+        if (player.episodes()[episode].score < min_score || !player.load(episode, states))
+            continue;
+
+        // states are recorded at the end of their tick, the action of tick
+        // i was decided on the state ending tick i-1
+        for (size_t i { 1 }; i < states.size(); ++i)
+        {
+            observer.observe(states[i-1], inputs);
+            LanderPlayField::action_outputs(states[i], outputs);
+            set.add(inputs, outputs);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,80 @@
+/*
+imitation.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef IMITATION_HPP
+#define IMITATION_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "genann.h"
+
+// Supervised samples for a net, stored row after row.
+struct training_set
+{
+    int inputs  { 0 };
+    int outputs { 0 };
+    std::vector<double> x; // size() * inputs
+    std::vector<double> y; // size() * outputs
+
+    size_t size() const
+    { return inputs ? x.size() / inputs : 0; }
+
+    void add(const double* sample_inputs, const double* sample_outputs)
+    {
+        x.insert(x.end(), sample_inputs,  sample_inputs  + inputs);
+        y.insert(y.end(), sample_outputs, sample_outputs + outputs);
+    }
+};
+
+struct backprop_params
+{
+    double   learning_rate { 0.01 }; // per batch, applied to the mean of its samples
+    size_t   batch_size    { 64 };
+    int      epochs        { 20 };
+    unsigned threads       { 1 };    // each batch is split over this many threads
+    bool     fresh_start   { false }; // replace the weights with random ones instead of refining them
+};
+
+// Minibatch gradient descent on the squared error, in a shuffled order drawn
+// from the calling thread's generator. Every thread backpropagates its share
+// of a batch into its own accumulator on its own copy of the net, and the
+// accumulators are summed in a fixed order before the step, so the result
+// only depends on the seed and the thread count.
+//
+// Raw inputs such as positions in pixels would saturate the activations, so
+// the descent runs on standardized inputs : the first layer is rewritten to
+// take them before training and rewritten back after, the net computing the
+// same function on raw inputs throughout.
+// Returns the mean squared error over the last epoch.
+double train_network(genann* ann, const training_set& set, const backprop_params& params);
+
+// Lander demonstrations from a trajectory log (see trajectory.hpp) : each
+// tick of an episode scoring at least min_score gives a sample, the net
+// inputs of the state before the tick and the outputs producing its action.
+// Returns false if the log can't be read.
+bool load_demonstrations(const std::string& path, float min_score, training_set& set);
+
+#endif // IMITATION_HPP
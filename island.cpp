@@ -0,0 +1,332 @@
+/*
+island.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "island.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include "common.hpp"
+#include "playfield.hpp"
+#include "population.hpp"
+#include "random.hpp"
+
+#include "genann.h"
+
+genome_mailbox::genome_mailbox(void *memory, size_t capacity, int weight_count, bool initialize)
+    : m_slots(capacity + 1), m_weight_count(weight_count)
+{
+    char* bytes = static_cast<char*>(memory);
+    m_control = reinterpret_cast<control*>(bytes);
+    m_weights = reinterpret_cast<double*>(bytes + sizeof(control));
+    m_scores  = reinterpret_cast<float*>(m_weights + m_slots * m_weight_count);
+
+    if (initialize)
+    {
+        new (&m_control->head) std::atomic<uint64_t>(0);
+        new (&m_control->tail) std::atomic<uint64_t>(0);
+    }
+}
+
+size_t genome_mailbox::bytes(size_t capacity, int weight_count)
+{
+    return sizeof(control) + (capacity + 1) * (sizeof(double) * weight_count + sizeof(float));
+}
+
+bool genome_mailbox::push(const double *weights, float score)
+{
+    uint64_t tail = m_control->tail.load(std::memory_order_relaxed);
+    uint64_t next = (tail + 1) % m_slots;
+    if (next == m_control->head.load(std::memory_order_acquire))
+        return false;
+
+    std::memcpy(m_weights + tail * m_weight_count, weights, sizeof(double) * m_weight_count);
+    m_scores[tail] = score;
+    m_control->tail.store(next, std::memory_order_release);
+    return true;
+}
+
+bool genome_mailbox::pop(double *weights, float &score)
+{
+    uint64_t head = m_control->head.load(std::memory_order_relaxed);
+    if (head == m_control->tail.load(std::memory_order_acquire))
+        return false;
+
+    std::memcpy(weights, m_weights + head * m_weight_count, sizeof(double) * m_weight_count);
+    score = m_scores[head];
+    m_control->head.store((head + 1) % m_slots, std::memory_order_release);
+    return true;
+}
+
+std::vector<std::pair<size_t, size_t>> migration_routes(const std::string &topology, size_t island_count)
+{
+    std::vector<std::pair<size_t, size_t>> routes;
+    if (island_count < 2)
+        return routes;
+
+    for (size_t i { 0 }; i < island_count; ++i)
+    {
+        if (topology == "ring")
+            routes.emplace_back(i, (i + 1) % island_count);
+        else if (topology == "bi_ring")
+        {
+            routes.emplace_back(i, (i + 1) % island_count);
+            if (island_count > 2)
+                routes.emplace_back(i, (i + island_count - 1) % island_count);
+        }
+        else if (topology == "complete")
+        {
+            for (size_t j { 0 }; j < island_count; ++j)
+            {
+                if (j != i)
+                    routes.emplace_back(i, j);
+            }
+        }
+    }
+
+    return routes;
+}
+
+size_t mailbox_capacity(const experiment_config &config)
+{
+    // what a route carries over two intervals
+    return 2 * std::max<size_t>(config.migrants, 1);
+}
+
+int weight_count_of(const experiment_config& config)
+{
+    std::unique_ptr<PlayField> probe(make_field(config.environment, sf::Vector2i{gameWidth, gameHeight}));
+    if (!probe)
+        return 0;
+    probe->hidden_layers  = config.hidden_layers;
+    probe->hidden_neurons = config.hidden_neurons;
+    probe->reset();
+    int count = probe->net.nn->total_weights;
+    nn_free(probe->net);
+    return count;
+}
+
+bool islands_can_run(const experiment_config& config)
+{
+    // the smallest population, without the logs, recordings and imitation
+    // training a real one sets up on the way
+    experiment_config probe = config;
+    probe.population          = 2;
+    probe.coevolution_threads = 1;
+    probe.imitation_log.clear();
+    probe.record_dir.clear();
+    probe.prune_log_dir.clear();
+    probe.diversity_log_dir.clear();
+    return population(probe).valid();
+}
+
+void run_island(const experiment_config& config, const island_context& context, island_outcome& outcome)
+{
+    experiment_config island_config = config;
+    island_config.name += "/island" + std::to_string(context.index);
+
+    seed_random(config.seed + 7919 * context.index);
+
+    population pop(island_config);
+    if (!pop.valid())
+    {
+        outcome.failed = true;
+        return;
+    }
+    auto& fields = pop.fields();
+    const int weight_count = fields[0]->net.nn->total_weights;
+    const size_t max_arrivals = fields.size() - parent_count;
+
+    bool resumed = context.resume && pop.load(context.checkpoint);
+    // a resumed island must not replay the random numbers of its first life
+    if (resumed)
+        seed_random(config.seed + 7919 * context.index + 104729 * (pop.generation() + 1));
+
+    std::vector<double> migrant(weight_count);
+    std::vector<size_t> ranking(fields.size());
+
+    while (resumed || pop.generation() + 1 < config.generations)
+    {
+        if (!resumed)
+        {
+            pop.advance();
+
+            // arrivals replace the last fields, where random immigrants live
+            size_t arrivals = 0;
+            for (auto* mailbox : context.incoming)
+            {
+                float score;
+                while (arrivals < max_arrivals && mailbox->pop(migrant.data(), score))
+                {
+                    auto* field = fields[fields.size() - 1 - arrivals++];
+                    std::memcpy(field->net.nn->weight, migrant.data(), sizeof(double) * weight_count);
+                }
+            }
+            outcome.received += arrivals;
+
+            if (!context.checkpoint.empty() && pop.generation() % config.migration_interval == 0)
+                pop.save(context.checkpoint);
+        }
+        resumed = false;
+
+        pop.evaluate();
+
+        int generation = pop.generation();
+        if ((generation + 1) % config.migration_interval == 0 && !context.outgoing.empty())
+        {
+            for (size_t i { 0 }; i < ranking.size(); ++i)
+                ranking[i] = i;
+            size_t sent = std::min(config.migrants, ranking.size());
+            std::partial_sort(ranking.begin(), ranking.begin() + sent, ranking.end(), [&](size_t lhs, size_t rhs)
+            { return fields[lhs]->score() > fields[rhs]->score(); });
+
+            for (auto* mailbox : context.outgoing)
+            {
+                for (size_t i { 0 }; i < sent; ++i)
+                {
+                    const auto* field = fields[ranking[i]];
+                    if (!mailbox->push(field->net.nn->weight, field->score()))
+                        ++outcome.dropped;
+                }
+            }
+        }
+    }
+
+    outcome.result = pop.stats();
+    const auto* champion = pop.champion();
+    outcome.champion.assign(champion->net.nn->weight, champion->net.nn->weight + weight_count);
+    outcome.champion_score = champion->score();
+}
+
+experiment_result combine_islands(const experiment_config &config, const std::vector<island_outcome> &outcomes)
+{
+    experiment_result total;
+    total.name       = config.name;
+    total.best_score = total.final_best = -std::numeric_limits<float>::infinity();
+
+    const island_outcome* best = &outcomes[0];
+    unsigned long long received = 0, dropped = 0;
+    for (const auto& outcome : outcomes)
+    {
+        const auto& result = outcome.result;
+        total.generations  = std::max(total.generations, result.generations);
+        total.best_score   = std::max(total.best_score, result.best_score);
+        total.final_best   = std::max(total.final_best, result.final_best);
+        total.final_mean  += result.final_mean / outcomes.size();
+        total.evaluations += result.evaluations;
+        total.ticks       += result.ticks;
+        total.pruned      += result.pruned;
+        total.early_bred  += result.early_bred;
+        total.cache_hits   += result.cache_hits;
+        total.cache_misses += result.cache_misses;
+        received += outcome.received;
+        dropped  += outcome.dropped;
+
+        if (outcome.champion_score > best->champion_score)
+            best = &outcome;
+    }
+
+    if (outcomes.size() > 1)
+        fprintf(stderr, "%s: %llu migrants received, %llu dropped on full mailboxes\n", config.name.c_str(), received, dropped);
+
+    auto champion_path = output_path(config, config.checkpoint_dir, ".net");
+    if (!champion_path.empty() && !best->champion.empty())
+    {
+        std::unique_ptr<PlayField> probe(make_field(config.environment, sf::Vector2i{gameWidth, gameHeight}));
+        probe->hidden_layers  = config.hidden_layers;
+        probe->hidden_neurons = config.hidden_neurons;
+        probe->reset();
+        std::memcpy(probe->net.nn->weight, best->champion.data(), sizeof(double) * best->champion.size());
+
+        if (FILE* out = fopen(champion_path.c_str(), "w"))
+        {
+            genann_write(probe->net.nn, out);
+            fclose(out);
+        }
+        else
+            perror(champion_path.c_str());
+
+        nn_free(probe->net);
+    }
+
+    return total;
+}
+
+experiment_result run_islands(const experiment_config &config)
+{
+    const int weight_count = weight_count_of(config);
+    auto routes = migration_routes(config.migration_topology, config.islands);
+    if (!weight_count || (config.islands > 1 && routes.empty()))
+    {
+        fprintf(stderr, "%s: unknown environment or migration topology\n", config.name.c_str());
+        experiment_result result;
+        result.name   = config.name;
+        result.failed = true;
+        return result;
+    }
+
+    const size_t capacity = mailbox_capacity(config);
+    std::vector<std::unique_ptr<char[]>> memory;
+    std::vector<std::unique_ptr<genome_mailbox>> mailboxes;
+    std::vector<island_context> contexts(config.islands);
+    for (size_t i { 0 }; i < config.islands; ++i)
+        contexts[i].index = i;
+    for (const auto& route : routes)
+    {
+        memory.emplace_back(new char[genome_mailbox::bytes(capacity, weight_count)]);
+        mailboxes.emplace_back(new genome_mailbox(memory.back().get(), capacity, weight_count, true));
+        contexts[route.first].outgoing.push_back(mailboxes.back().get());
+        contexts[route.second].incoming.push_back(mailboxes.back().get());
+    }
+
+    std::vector<island_outcome> outcomes(config.islands);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i { 0 }; i < config.islands; ++i)
+        threads.emplace_back(run_island, std::cref(config), std::cref(contexts[i]), std::ref(outcomes[i]));
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& outcome : outcomes)
+    {
+        if (outcome.failed)
+        {
+            experiment_result result;
+            result.name   = config.name;
+            result.failed = true;
+            return result;
+        }
+    }
+
+    auto total = combine_islands(config, outcomes);
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total;
+}
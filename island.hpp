@@ -0,0 +1,116 @@
+/*
+island.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef ISLAND_HPP
+#define ISLAND_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "experiment.hpp"
+
+// Lock-free single producer / single consumer queue of genomes, one per
+// directed migration route. It works in place over a block of bytes() bytes,
+// so the same queue can live in the heap or in memory shared between
+// processes : genomes are plain weight arrays copied in and out, nothing is
+// serialized. A full mailbox drops the migrant instead of making the sender wait.
+class genome_mailbox
+{
+public:
+    // Views memory laid out by a previous call with initialize set (possibly in another process).
+    genome_mailbox(void* memory, size_t capacity, int weight_count, bool initialize);
+
+    static size_t bytes(size_t capacity, int weight_count);
+
+    bool push(const double* weights, float score);
+    bool pop(double* weights, float& score);
+
+private:
+    struct control
+    {
+        // on their own cache lines, each is only written by one side
+        std::atomic<uint64_t> head; // consumer
+        char pad_0[64 - sizeof(std::atomic<uint64_t>)];
+        std::atomic<uint64_t> tail; // producer
+        char pad_1[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    size_t   m_slots;
+    int      m_weight_count;
+    control* m_control;
+    float*   m_scores;  // m_slots
+    double*  m_weights; // m_slots * m_weight_count
+};
+
+// Directed (from, to) routes between island_count islands :
+// "ring" (to the next one), "bi_ring" (to both neighbours) or "complete".
+// Empty for an unknown topology.
+std::vector<std::pair<size_t, size_t>> migration_routes(const std::string& topology, size_t island_count);
+
+struct island_outcome
+{
+    experiment_result result;
+    std::vector<double> champion; // weights
+    float champion_score { 0 };
+    unsigned long long received { 0 };
+    unsigned long long dropped  { 0 };
+    bool failed { false }; // the island's population could not be set up
+};
+
+struct island_context
+{
+    size_t index { 0 };
+    std::vector<genome_mailbox*> outgoing;
+    std::vector<genome_mailbox*> incoming;
+
+    std::string checkpoint; // if set, the population is saved there every migration interval
+    bool resume { false };  // start from the checkpoint instead of random nets
+};
+
+// Runs one island to the end of the experiment, on the calling thread.
+// Sets outcome.failed, without running anything, when the configuration
+// can't build a population (see population::valid()).
+void run_island(const experiment_config& config, const island_context& context, island_outcome& outcome);
+
+// Routes, mailbox sizes and the combination of island outcomes are common to
+// the thread and process flavours.
+size_t mailbox_capacity(const experiment_config& config);
+int    weight_count_of(const experiment_config& config);
+// Whether a population of the configuration can be built at all, checked
+// once instead of failing on every island (a missing scenario bank...).
+bool   islands_can_run(const experiment_config& config);
+experiment_result combine_islands(const experiment_config& config, const std::vector<island_outcome>& outcomes);
+
+// Evolves config.islands sub-populations of config.population fields, one
+// thread each with its own generator (seed + island index). Every
+// migration_interval generations an island posts copies of its `migrants` best
+// genomes on its outgoing routes, and takes whatever reached it in place of its
+// last fields (the random immigrants first). Islands never wait for each other.
+experiment_result run_islands(const experiment_config& config);
+
+#endif // ISLAND_HPP
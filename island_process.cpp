@@ -0,0 +1,479 @@
+/*
+island_process.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "island_process.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "island.hpp"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+const uint32_t segment_magic = 0x4e4e4953; // "NNIS"
+// between two rounds of checking on the workers
+const useconds_t worker_poll_interval_us = 20000;
+// exit status of a worker whose configuration can't build a population :
+// restarting it would fail the same way
+const int worker_unusable_config = 3;
+
+struct segment_header
+{
+    uint32_t magic;
+    uint32_t islands;
+    uint32_t routes;
+    int32_t  weight_count;
+    uint64_t capacity;
+    uint64_t size;
+};
+
+// Written once by its worker, read by the coordinator after `done`.
+// The champion's weights follow.
+struct island_status
+{
+    std::atomic<int> done;
+    int   generations;
+    float best_score, final_best, final_mean, champion_score;
+    unsigned long long evaluations, ticks, pruned, early_bred, cache_hits, cache_misses, received, dropped;
+};
+
+size_t align_up(size_t size)
+{
+    return (size + 63) & ~size_t(63);
+}
+
+struct segment_layout
+{
+    size_t status_offset, status_stride;
+    size_t mailbox_offset, mailbox_stride;
+    size_t size;
+
+    segment_layout(size_t islands, size_t routes, size_t capacity, int weight_count)
+    {
+        status_offset  = align_up(sizeof(segment_header));
+        status_stride  = align_up(sizeof(island_status) + sizeof(double) * weight_count);
+        mailbox_offset = status_offset + islands * status_stride;
+        mailbox_stride = align_up(genome_mailbox::bytes(capacity, weight_count));
+        size           = mailbox_offset + routes * mailbox_stride;
+    }
+};
+
+island_status* status_of(char* segment, const segment_layout& layout, size_t island)
+{
+    return reinterpret_cast<island_status*>(segment + layout.status_offset + island * layout.status_stride);
+}
+
+double* champion_of(island_status* status)
+{
+    return reinterpret_cast<double*>(status + 1);
+}
+
+std::string self_path()
+{
+    // resolved once : after a launcher exec, /proc/self/exe is the launcher
+    char path[4096];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length <= 0)
+        return "";
+    path[length] = '\0';
+    return path;
+}
+
+std::string substitute(std::string text, const char* pattern, const std::string& value)
+{
+    size_t at;
+    while ((at = text.find(pattern)) != std::string::npos)
+        text.replace(at, std::strlen(pattern), value);
+    return text;
+}
+
+pid_t start_worker(const experiment_config& config, const std::string& executable, const std::string& segment,
+                   size_t island, const std::string& checkpoint, bool resume)
+{
+    std::vector<std::string> arguments;
+
+    const std::string node = std::to_string(island % config.worker_nodes);
+    size_t begin = 0;
+    const auto& launcher = config.worker_launcher;
+    while ((begin = launcher.find_first_not_of(" \t", begin)) != std::string::npos)
+    {
+        size_t end = std::min(launcher.find_first_of(" \t", begin), launcher.size());
+        auto token = launcher.substr(begin, end - begin);
+        arguments.push_back(substitute(substitute(token, "{island}", std::to_string(island)), "{node}", node));
+        begin = end;
+    }
+
+    arguments.insert(arguments.end(), { executable, "island-worker", segment, std::to_string(island), checkpoint });
+    if (resume)
+        arguments.push_back("--resume");
+    for (auto& argument : config_arguments(config))
+        arguments.push_back(std::move(argument));
+
+    std::vector<char*> argv;
+    for (auto& argument : arguments)
+        argv.push_back(&argument[0]);
+    argv.push_back(nullptr);
+
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // orphaned workers would keep writing to a segment nobody reads
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        execvp(argv[0], argv.data());
+        perror(argv[0]);
+        _exit(127);
+    }
+    if (pid < 0)
+        perror("fork");
+    return pid;
+}
+
+}
+
+experiment_result run_island_processes(const experiment_config &config)
+{
+    experiment_result failed;
+    failed.name   = config.name;
+    failed.failed = true;
+
+    const int weight_count = weight_count_of(config);
+    auto routes = migration_routes(config.migration_topology, config.islands);
+    if (!weight_count || routes.empty())
+    {
+        fprintf(stderr, "%s: unknown environment or migration topology\n", config.name.c_str());
+        return failed;
+    }
+
+    // caught here once rather than by every worker
+    if (!islands_can_run(config))
+        return failed;
+
+    const std::string executable = self_path();
+    if (executable.empty())
+    {
+        perror("/proc/self/exe");
+        return failed;
+    }
+
+    const size_t capacity = mailbox_capacity(config);
+    segment_layout layout(config.islands, routes.size(), capacity, weight_count);
+
+    static std::atomic<unsigned> segment_counter { 0 };
+    const std::string segment_name = "/nnislands." + std::to_string(getpid()) + "." + std::to_string(segment_counter++);
+
+    int fd = shm_open(segment_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        perror(segment_name.c_str());
+        return failed;
+    }
+    if (ftruncate(fd, (off_t)layout.size) != 0)
+    {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(segment_name.c_str());
+        return failed;
+    }
+    void* mapping = mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        perror("mmap");
+        shm_unlink(segment_name.c_str());
+        return failed;
+    }
+
+    char* segment = static_cast<char*>(mapping);
+    auto* header = new (segment) segment_header;
+    header->magic        = segment_magic;
+    header->islands      = (uint32_t)config.islands;
+    header->routes       = (uint32_t)routes.size();
+    header->weight_count = weight_count;
+    header->capacity     = capacity;
+    header->size         = layout.size;
+    for (size_t i { 0 }; i < config.islands; ++i)
+        new (&status_of(segment, layout, i)->done) std::atomic<int>(0);
+    for (size_t i { 0 }; i < routes.size(); ++i)
+        genome_mailbox(segment + layout.mailbox_offset + i * layout.mailbox_stride, capacity, weight_count, true);
+
+    // checkpoints land next to the champion, or in /tmp when there is nowhere to keep them
+    std::vector<std::string> checkpoints(config.islands);
+    for (size_t i { 0 }; i < config.islands; ++i)
+    {
+        experiment_config island_config = config;
+        island_config.name += "/island" + std::to_string(i);
+        checkpoints[i] = config.checkpoint_dir.empty()
+                ? "/tmp" + segment_name + ".island" + std::to_string(i) + ".pop"
+                : output_path(island_config, config.checkpoint_dir, ".pop");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<pid_t> workers(config.islands, -1);
+    std::vector<int> restarts(config.islands, 0);
+    bool unusable = false;
+    size_t running = 0;
+    for (size_t i { 0 }; i < config.islands; ++i)
+    {
+        workers[i] = start_worker(config, executable, segment_name, i, checkpoints[i], false);
+        running += workers[i] > 0;
+    }
+
+    // only this experiment's own workers are waited for : a sweep may run
+    // several process-island experiments side by side
+    while (running > 0)
+    {
+        int status = 0;
+        size_t island = workers.size();
+        for (size_t i { 0 }; i < workers.size() && island == workers.size(); ++i)
+        {
+            if (workers[i] <= 0)
+                continue;
+
+            pid_t pid = waitpid(workers[i], &status, WNOHANG);
+            if (pid == workers[i])
+                island = i;
+            else if (pid < 0 && errno != EINTR)
+            {
+                perror("waitpid");
+                workers[i] = -1;
+                --running;
+            }
+        }
+        if (island == workers.size())
+        {
+            usleep(worker_poll_interval_us);
+            continue;
+        }
+
+        workers[island] = -1;
+        --running;
+
+        bool finished = WIFEXITED(status) && WEXITSTATUS(status) == 0
+                && status_of(segment, layout, island)->done.load(std::memory_order_acquire);
+        if (finished)
+            continue;
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == worker_unusable_config)
+        {
+            fprintf(stderr, "%s: island %zu can't run this configuration, not restarting it\n", config.name.c_str(), island);
+            unusable = true;
+            continue;
+        }
+
+        if (restarts[island]++ < config.max_restarts)
+        {
+            fprintf(stderr, "%s: island %zu worker %s, restarting from its checkpoint (%d/%d)\n", config.name.c_str(), island,
+                    WIFSIGNALED(status) ? strsignal(WTERMSIG(status)) : "failed", restarts[island], config.max_restarts);
+            workers[island] = start_worker(config, executable, segment_name, island, checkpoints[island], true);
+            running += workers[island] > 0;
+        }
+        else
+            fprintf(stderr, "%s: island %zu gave up after %d restarts\n", config.name.c_str(), island, config.max_restarts);
+    }
+
+    std::vector<island_outcome> outcomes(config.islands);
+    size_t completed = 0;
+    for (size_t i { 0 }; i < config.islands; ++i)
+    {
+        auto* status = status_of(segment, layout, i);
+        auto& outcome = outcomes[i];
+        if (!status->done.load(std::memory_order_acquire))
+        {
+            outcome.champion_score = -std::numeric_limits<float>::infinity();
+            outcome.result.best_score = outcome.result.final_best = outcome.champion_score;
+            continue;
+        }
+        ++completed;
+
+        outcome.result.generations = status->generations;
+        outcome.result.best_score  = status->best_score;
+        outcome.result.final_best  = status->final_best;
+        outcome.result.final_mean  = status->final_mean;
+        outcome.result.evaluations = status->evaluations;
+        outcome.result.ticks       = status->ticks;
+        outcome.result.pruned      = status->pruned;
+        outcome.result.early_bred  = status->early_bred;
+        outcome.result.cache_hits   = status->cache_hits;
+        outcome.result.cache_misses = status->cache_misses;
+        outcome.received           = status->received;
+        outcome.dropped            = status->dropped;
+        outcome.champion_score     = status->champion_score;
+        outcome.champion.assign(champion_of(status), champion_of(status) + weight_count);
+    }
+
+    munmap(mapping, layout.size);
+    shm_unlink(segment_name.c_str());
+    if (config.checkpoint_dir.empty())
+    {
+        for (const auto& checkpoint : checkpoints)
+            remove(checkpoint.c_str());
+    }
+
+    // an island that gave up is left out, but with none left nothing was measured
+    if (unusable || !completed)
+        return failed;
+
+    auto total = combine_islands(config, outcomes);
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total;
+}
+
+int island_worker_main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: NeuralNetworkTrainer island-worker <segment> <island> <checkpoint> [--resume] key=value...\n");
+        return EXIT_FAILURE;
+    }
+
+    const std::string segment_name = argv[0];
+    island_context context;
+    context.index      = (size_t)std::atoi(argv[1]);
+    context.checkpoint = argv[2];
+
+    experiment_config config;
+    for (int i { 3 }; i < argc; ++i)
+    {
+        const char* equals = std::strchr(argv[i], '=');
+        if (!strcmp(argv[i], "--resume"))
+            context.resume = true;
+        else if (!equals || !set_config_key(config, std::string(argv[i], equals - argv[i]), equals + 1))
+        {
+            fprintf(stderr, "island-worker: bad setting '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int fd = shm_open(segment_name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+    {
+        perror(segment_name.c_str());
+        return EXIT_FAILURE;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(segment_header))
+    {
+        fprintf(stderr, "%s: not an island segment\n", segment_name.c_str());
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    char* segment = static_cast<char*>(mapping);
+    const auto* header = reinterpret_cast<const segment_header*>(segment);
+    auto routes = migration_routes(config.migration_topology, config.islands);
+    segment_layout layout(header->islands, header->routes, header->capacity, header->weight_count);
+    if (header->magic != segment_magic || layout.size != header->size || (size_t)info.st_size < layout.size
+            || header->routes != routes.size() || context.index >= header->islands)
+    {
+        fprintf(stderr, "%s: segment does not match the configuration\n", segment_name.c_str());
+        munmap(mapping, info.st_size);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::unique_ptr<genome_mailbox>> mailboxes;
+    for (size_t i { 0 }; i < routes.size(); ++i)
+    {
+        mailboxes.emplace_back(new genome_mailbox(segment + layout.mailbox_offset + i * layout.mailbox_stride,
+                                                  header->capacity, header->weight_count, false));
+        if (routes[i].first == context.index)
+            context.outgoing.push_back(mailboxes.back().get());
+        if (routes[i].second == context.index)
+            context.incoming.push_back(mailboxes.back().get());
+    }
+
+    island_outcome outcome;
+    run_island(config, context, outcome);
+    if (outcome.failed)
+    {
+        munmap(mapping, info.st_size);
+        return worker_unusable_config;
+    }
+
+    auto* status = status_of(segment, layout, context.index);
+    status->generations    = outcome.result.generations;
+    status->best_score     = outcome.result.best_score;
+    status->final_best     = outcome.result.final_best;
+    status->final_mean     = outcome.result.final_mean;
+    status->champion_score = outcome.champion_score;
+    status->evaluations    = outcome.result.evaluations;
+    status->ticks          = outcome.result.ticks;
+    status->pruned         = outcome.result.pruned;
+    status->early_bred     = outcome.result.early_bred;
+    status->cache_hits     = outcome.result.cache_hits;
+    status->cache_misses   = outcome.result.cache_misses;
+    status->received       = outcome.received;
+    status->dropped        = outcome.dropped;
+    std::copy(outcome.champion.begin(), outcome.champion.end(), champion_of(status));
+    status->done.store(1, std::memory_order_release);
+
+    munmap(mapping, info.st_size);
+    return EXIT_SUCCESS;
+}
+
+#else
+
+experiment_result run_island_processes(const experiment_config &config)
+{
+    fprintf(stderr, "%s: island processes need Linux, running the islands as threads\n", config.name.c_str());
+    return run_islands(config);
+}
+
+int island_worker_main(int, char **)
+{
+    fprintf(stderr, "island-worker: not supported on this platform\n");
+    return EXIT_FAILURE;
+}
+
+#endif
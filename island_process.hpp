@@ -0,0 +1,50 @@
+/*
+island_process.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef ISLAND_PROCESS_HPP
+#define ISLAND_PROCESS_HPP
+
+#include "experiment.hpp"
+
+// Islands as separate worker processes of this same executable, for fault
+// isolation and per-socket placement. The coordinator creates one POSIX
+// shared memory segment holding every genome_mailbox of the migration
+// routes plus a status block per island, then starts each worker as
+//
+//   [worker_launcher] NeuralNetworkTrainer island-worker <segment> <island> <checkpoint> [--resume] key=value...
+//
+// where the launcher (e.g. "numactl --cpunodebind={node} --membind={node}")
+// gets {island} and {node} substituted. Genomes move between workers as raw
+// weight arrays through the mailboxes, exactly as between threads. A worker
+// that dies is started again with --resume from its last checkpoint, at most
+// max_restarts times ; an island that never finishes is left out of the result.
+// Checkpoints only hold the nets : with an evolution strategy, adaptive
+// mutation steps, a diversity target, co-evolution or novelty search, a
+// restarted worker starts its island over (see population::save()).
+experiment_result run_island_processes(const experiment_config& config);
+
+// Entry point of the island-worker subcommand, argv starting after it.
+int island_worker_main(int argc, char** argv);
+
+#endif // ISLAND_PROCESS_HPP
@@ -25,12 +25,15 @@ SOFTWARE.
 
 #include "lander.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <cassert>
 
 #include <SFML/Graphics/RenderTarget.hpp>
 
+#include "assets.hpp"
+
 inline double to_radians(double degrees)
 {
     return degrees * M_PI / 180.0;
@@ -39,9 +42,9 @@ inline double to_radians(double degrees)
 LanderPlayField::LanderPlayField(sf::Vector2i size)
     : m_size(size)
 {
-    m_rocket_texture.loadFromFile("resources/lander_spritesheet.png");
+    time_limit = 10.f; // kill agents that take more than 10 sec to land
 
-    m_rocket_sprite.setTexture(m_rocket_texture);
+    m_rocket_sprite.setTexture(shared_texture("resources/lander_spritesheet.png"));
     m_rocket_sprite.setTextureRect({40, 57, 20, 25});
     m_rocket_sprite.setScale(5.f, 5.f);
     m_rocket_sprite.setOrigin(20/2.f, 25/2.f);
@@ -57,8 +60,7 @@ LanderPlayField::LanderPlayField(sf::Vector2i size)
     m_landing_pad.setOutlineThickness(3);
     m_landing_pad.setOutlineColor(sf::Color::White);
 
-    m_da_font.loadFromFile("resources/sansation.ttf");
-    m_score_text.setFont(m_da_font);
+    m_score_text.setFont(shared_font("resources/sansation.ttf"));
     m_score_text.setCharacterSize(80);
     m_score_text.move(20, 0);
 
@@ -69,11 +71,24 @@ void LanderPlayField::reset()
 {
     // Inputs : algebraic_pad_distance_x, y, vert_speed, horiz_speed, angle, steer, thrust
     // Outputs : thrust, steer
-    nn_init(net, 5, 1, 4, 2);
+    nn_init(net, input_size(), hidden_layers, hidden_neurons, output_count);
 
+    m_ground_shape = sf::VertexArray(sf::LineStrip);
+    if (ground)
+    {
+        for (const auto& point : ground->points())
+            m_ground_shape.append(sf::Vertex(point, sf::Color::White));
+    }
+
+    restart();
+}
+
+void LanderPlayField::restart()
+{
     m_velocity = {0, 0};
     m_angle = 0;
     m_elapsed_time = 0;
+    m_update_count = 0;
     m_score = 1;
     m_score_text.setFillColor(sf::Color::White);
     m_border.setFillColor(sf::Color::Transparent);
@@ -81,6 +96,16 @@ void LanderPlayField::reset()
     m_rocket_sprite.setPosition(sf::Vector2f{m_size / 2} - sf::Vector2f{m_size.x/4.f, m_size.y/4.f});
 
     m_angle = 45;
+    if (start)
+    {
+        m_rocket_sprite.setPosition(start->x, start->y);
+        m_velocity = {start->vx, start->vy};
+        m_angle    = start->angle;
+    }
+    m_rocket_sprite.setRotation(m_angle);
+    corners(m_corners);
+    m_landed    = false;
+    m_rays_cast = false;
 
     thrust = 0.2;
     steer  = 0;
@@ -88,16 +113,26 @@ void LanderPlayField::reset()
 
 void LanderPlayField::run_nn()
 {
-    //net.inputs[0] = m_rocket_sprite.getPosition().x;
-    net.inputs[0] = m_rocket_sprite.getPosition().y;
-    net.inputs[1] = m_velocity.x;
-    net.inputs[2] = m_velocity.y;
-    net.inputs[3] = m_angle;
-    net.inputs[4] = m_rocket_sprite.getPosition().x - (m_landing_pad.getPosition().x+m_landing_pad.getLocalBounds().width/2.f);
-    //net.inputs[5] = steer;
-    //net.inputs[6] = thrust;
+    observe(state(), net.inputs);
 
-    nn_run(net);
+    if (ray_count > 0)
+    {
+        if (!m_rays_cast)
+        {
+            m_rays.clear();
+            pending_rays(m_rays);
+            m_ray_distances.resize(m_rays.size());
+            if (ground)
+                ground->raycast(m_rays.data(), m_rays.size(), m_ray_distances.data());
+            else
+                std::fill(m_ray_distances.begin(), m_ray_distances.end(), ray_range);
+        }
+        for (int i { 0 }; i < ray_count; ++i)
+            net.inputs[input_count + i] = m_ray_distances[i] / ray_range;
+        m_rays_cast = false;
+    }
+
+    run_net();
 
     thrust = net.outputs[0];
     steer  = 1 - net.outputs[1] * 2; // normalize to [-1; 1]
@@ -110,17 +145,22 @@ void LanderPlayField::update(float delta_time)
 
     m_elapsed_time += delta_time;
 
-    if (m_elapsed_time > 10.f) // kill agents that take more than 10 sec to land
+    if (time_limit > 0 && m_elapsed_time > time_limit)
     {
         m_playing = false;
         return;
     }
 
-    run_nn();
+    if (control_tick())
+        run_nn();
 
-    apply_forces(delta_time);
-    move_rocket();
-    check_collisions();
+    const int substeps = std::max(physics_substeps, 1);
+    for (int i { 0 }; i < substeps && playing(); ++i)
+    {
+        apply_forces(delta_time / substeps);
+        move_rocket(1.f / substeps);
+        check_collisions();
+    }
 
     animate();
 
@@ -130,6 +170,9 @@ void LanderPlayField::update(float delta_time)
     else
         m_score -= delta_time * 5;
 
+    if (recording)
+        recording->push(state());
+
     char buffer[1024];
     snprintf(buffer, sizeof(buffer), "Score : %.3f", m_score);
 
@@ -145,6 +188,8 @@ void LanderPlayField::draw(sf::RenderTarget &target, sf::RenderStates states) co
         //target.draw(m_ball, states);
     }
     target.draw(m_rocket_sprite, states);
+    if (ground)
+        target.draw(m_ground_shape, states);
     target.draw(m_landing_pad, states);
     target.draw(m_score_text, states);
     target.draw(m_border, states);
@@ -169,14 +214,65 @@ void LanderPlayField::check_collisions()
 {
     auto bounding_box = m_rocket_sprite.getGlobalBounds();
 
-    if (bounding_box.top > 157*4+60 || bounding_box.left < 0 || bounding_box.left + bounding_box.width > m_size.x ||
-            bounding_box.top < 0) // hardcoded for your pleasure
+    bool landed = bounding_box.top > 157*4+60; // hardcoded for your pleasure
+    if (ground)
     {
+        // the outline crossing the ground, or a corner going through it since the last check
+        sf::Vector2f points[4];
+        corners(points);
+        landed = false;
+        for (int i { 0 }; i < 4 && !landed; ++i)
+            landed = ground->crosses(points[i], points[(i+1) % 4]) || ground->crosses(m_corners[i], points[i]);
+        std::copy(points, points + 4, m_corners);
+    }
+
+    if (landed || bounding_box.left < 0 || bounding_box.left + bounding_box.width > m_size.x ||
+            bounding_box.top < 0)
+    {
+        m_landed  = landed;
         m_playing = false;
         calculate_score();
     }
 }
 
+bool LanderPlayField::touched_ground() const
+{
+    if (ground)
+        return m_landed;
+    return !(m_rocket_sprite.getGlobalBounds().top < 157*4+60);
+}
+
+void LanderPlayField::corners(sf::Vector2f *points) const
+{
+    auto bounds    = m_rocket_sprite.getLocalBounds();
+    auto transform = m_rocket_sprite.getTransform();
+    points[0] = transform.transformPoint({bounds.left, bounds.top});
+    points[1] = transform.transformPoint({bounds.left + bounds.width, bounds.top});
+    points[2] = transform.transformPoint({bounds.left + bounds.width, bounds.top + bounds.height});
+    points[3] = transform.transformPoint({bounds.left, bounds.top + bounds.height});
+}
+
+int LanderPlayField::pending_rays(std::vector<terrain::ray> &rays) const
+{
+    if (ray_count <= 0 || !playing() || !control_due())
+        return 0;
+
+    const sf::Vector2f origin = m_rocket_sprite.getPosition();
+    for (int i { 0 }; i < ray_count; ++i)
+    {
+        float offset = ray_count > 1 ? -ray_fan/2 + ray_fan * i / (ray_count - 1) : 0;
+        float angle  = to_radians(m_angle + 90 + offset);
+        rays.push_back({origin, {std::cos(angle), std::sin(angle)}, ray_range});
+    }
+    return ray_count;
+}
+
+void LanderPlayField::set_ray_distances(const float *distances)
+{
+    m_ray_distances.assign(distances, distances + ray_count);
+    m_rays_cast = true;
+}
+
 void LanderPlayField::calculate_score()
 {
     //m_score = 0;
@@ -213,7 +309,7 @@ void LanderPlayField::calculate_score()
     }
 
     // didn't touch the ground
-    if (m_rocket_sprite.getGlobalBounds().top < 157*4+60)
+    if (!touched_ground())
     {
         m_score = -100000 + m_rocket_sprite.getPosition().y; // reward lowest individuals
     }
@@ -224,6 +320,105 @@ float LanderPlayField::score() const
     return m_score;
 }
 
+float LanderPlayField::score_upper_bound() const
+{
+    // the score only decreases in flight
+    return playing() ? m_score + max_landing_bonus : m_score;
+}
+
+void LanderPlayField::objectives(float *values) const
+{
+    values[0] = -std::sqrt(m_velocity.x*m_velocity.x + m_velocity.y*m_velocity.y);
+    values[1] = -std::abs(m_angle);
+    values[2] = -std::abs(m_rocket_sprite.getPosition().x - (m_landing_pad.getPosition().x+m_landing_pad.getLocalBounds().width/2.f));
+    values[3] = -m_elapsed_time;
+}
+
+void LanderPlayField::behaviour(float *values) const
+{
+    values[0] = m_rocket_sprite.getPosition().x / m_size.x;
+    values[1] = m_rocket_sprite.getPosition().y / m_size.y;
+    values[2] = m_velocity.x / 10;
+    values[3] = m_velocity.y / 10;
+    values[4] = m_angle / 180;
+}
+
+float LanderPlayField::violation() const
+{
+    if (ground)
+    {
+        // clearance of the lowest corner
+        if (m_landed)
+            return 0;
+        float clearance = m_size.y;
+        for (const auto& corner : m_corners)
+            clearance = std::min(clearance, ground->raycast({corner, {0, 1}, (float)m_size.y}));
+        return clearance;
+    }
+
+    // same ground line as check_collisions()
+    return std::max(0.f, 157*4+60 - m_rocket_sprite.getGlobalBounds().top);
+}
+
+void LanderPlayField::finish(float score)
+{
+    m_score = score;
+    set_playing(false);
+}
+
+lander_state LanderPlayField::state() const
+{
+    lander_state state;
+    state.x      = m_rocket_sprite.getPosition().x;
+    state.y      = m_rocket_sprite.getPosition().y;
+    state.vx     = m_velocity.x;
+    state.vy     = m_velocity.y;
+    state.angle  = m_angle;
+    state.thrust = thrust;
+    state.steer  = steer;
+    return state;
+}
+
+void LanderPlayField::observe(const lander_state &state, double *inputs) const
+{
+    //inputs[0] = state.x;
+    inputs[0] = state.y;
+    inputs[1] = state.vx;
+    inputs[2] = state.vy;
+    inputs[3] = state.angle;
+    inputs[4] = state.x - (m_landing_pad.getPosition().x+m_landing_pad.getLocalBounds().width/2.f);
+    //inputs[5] = state.steer;
+    //inputs[6] = state.thrust;
+}
+
+void LanderPlayField::action_outputs(const lander_state &state, double *outputs)
+{
+    // inverse of run_nn()
+    outputs[0] = state.thrust;
+    outputs[1] = (1 - state.steer) / 2;
+}
+
+terrain LanderPlayField::generate_ground(unsigned seed, float roughness) const
+{
+    auto pad = m_landing_pad.getGlobalBounds();
+    terrain ground;
+    ground.generate(seed, sf::Vector2f{m_size}, pad.top, roughness, pad.left, pad.left + pad.width);
+    return ground;
+}
+
+void LanderPlayField::set_state(const lander_state &state, float elapsed_time)
+{
+    m_rocket_sprite.setPosition(state.x, state.y);
+    m_velocity     = {state.vx, state.vy};
+    m_angle        = state.angle;
+    thrust         = state.thrust;
+    steer          = state.steer;
+    m_elapsed_time = elapsed_time;
+
+    m_rocket_sprite.setRotation(m_angle);
+    animate();
+}
+
 void LanderPlayField::apply_forces(float delta_time)
 {
     assert(thrust >= 0 && thrust <= 1);
@@ -238,8 +433,9 @@ void LanderPlayField::apply_forces(float delta_time)
     m_angle += steering_speed * steer * delta_time;
 }
 
-void LanderPlayField::move_rocket()
+void LanderPlayField::move_rocket(float fraction)
 {
+    // velocities are in units per update
     m_rocket_sprite.setRotation(m_angle);
-    m_rocket_sprite.move(m_velocity);
+    m_rocket_sprite.move(m_velocity * fraction);
 }
@@ -26,11 +26,17 @@ SOFTWARE.
 #define LANDER_HPP
 
 #include "playfield.hpp"
+#include "terrain.hpp"
+#include "trajectory.hpp"
+
+#include <memory>
+#include <vector>
 
 #include <SFML/Graphics/RectangleShape.hpp>
 #include <SFML/Graphics/CircleShape.hpp>
 #include <SFML/Graphics/Texture.hpp>
 #include <SFML/Graphics/Sprite.hpp>
+#include <SFML/Graphics/VertexArray.hpp>
 
 #include <SFML/Graphics/Text.hpp>
 
@@ -41,20 +47,63 @@ public:
     const float        thrust_force   = -6.0f; // unit/s^2
     const float        steering_speed = 90.0f; // degrees/s
 
+    // most calculate_score() can add at touchdown : level, motionless, on the pad
+    const float max_landing_bonus = 3 + 3*100 + 200;
+
 public:
     LanderPlayField(sf::Vector2i size = {800, 600});
 
     void  reset() override;
+    void  restart() override;
     void  update(float dt) override;
     void  draw(sf::RenderTarget& target, sf::RenderStates states) const override;
     float score() const override;
+    float score_upper_bound() const override;
+    // touchdown speed, tilt, distance to the pad center and flight time, all negated ;
+    // not reaching the ground is a violation of its remaining altitude
+    int   objective_count() const override
+    { return 4; }
+    void  objectives(float* values) const override;
+    float violation() const override;
+    // final position, velocity and angle, roughly within [-1; 1]
+    int   behaviour_size() const override
+    { return 5; }
+    void  behaviour(float* values) const override;
+    bool  deterministic() const override
+    { return true; }
+    void  finish(float score) override;
+
+    static const int input_count  = 5; // before the rays
+    static const int output_count = 2;
+
+    int input_size() const
+    { return input_count + ray_count; }
+
+    // The rays the next update() will feed the net, if it queries the net,
+    // appended to rays : how many.
+    int  pending_rays(std::vector<terrain::ray>& rays) const;
+    // Their distances, cast along with those of other fields ; without them
+    // update() casts its rays itself.
+    void set_ray_distances(const float* distances);
+
+    lander_state state() const;
+    // What the net is fed in a given state, and what it outputs for an action.
+    void observe(const lander_state& state, double* inputs) const;
+    static void action_outputs(const lander_state& state, double* outputs);
+    // Random hills around this field's landing pad, for ground.
+    terrain generate_ground(unsigned seed, float roughness) const;
+    // Shows a recorded state, for replays : no physics involved.
+    void set_state(const lander_state& state, float elapsed_time);
 
 private:
     void run_nn();
     void apply_forces(float delta_time);
-    void move_rocket();
+    void move_rocket(float fraction);
     void animate();
     void check_collisions();
+    bool touched_ground() const;
+    // the rocket's outline, rotation included
+    void corners(sf::Vector2f* points) const;
 
     void calculate_score();
 
@@ -62,19 +111,34 @@ public:
     float thrust { 0 }; // ranges from  0 to 1
     float steer  { 0 }; // ranges from -1 to 1
 
+    trajectory_buffer* recording { nullptr }; // if set, receives the state of every tick
+
+    // Segment ground shared by the fields of a population, replacing the flat
+    // one : the rocket lands when its outline crosses it. Set before reset().
+    std::shared_ptr<const terrain> ground;
+    // distance rays fanned around the rocket's down axis, appended to the
+    // net inputs as fractions of ray_range (the whole range if no ground)
+    int   ray_count { 0 };
+    float ray_fan   { 120 }; // degrees
+    float ray_range { 600 };
+
 private:
     sf::Vector2f m_velocity {};
+    sf::Vector2f m_corners[4]; // as of the last collision check
+    bool         m_landed { false };
+    std::vector<terrain::ray> m_rays;
+    std::vector<float> m_ray_distances;
+    bool         m_rays_cast { false }; // by set_ray_distances() for the next net query
     float        m_angle { 0 };
 
     sf::Sprite  m_rocket_sprite;
-    sf::Texture m_rocket_texture;
 
     float m_elapsed_time { 0 };
     float m_score { 1 };
     sf::Vector2i m_size;
-    sf::Font         m_da_font;
     sf::RectangleShape m_border;
     sf::RectangleShape m_landing_pad;
+    sf::VertexArray    m_ground_shape;
     mutable sf::Text m_score_text;
 };
 
@@ -0,0 +1,370 @@
+/*
+lineage.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "lineage.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+
+const char lineage_magic[8] = { 'N', 'N', 'L', 'I', 'N', 'E', 'A', 'G' };
+
+struct lineage_header
+{
+    char    magic[8];
+    int32_t topology[4]; // inputs, hidden layers, hidden, outputs
+};
+
+static_assert(sizeof(lineage_entry) == 16, "index entries are stored as is");
+
+// Record : varint field, varint distance back to the ancestor's id (0 for a
+// whole genome), then either total_weights doubles or a varint count of
+// (varint gap since the previous changed index, double) pairs.
+
+void put_varint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+bool get_varint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift { 0 }; in < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void put_double(std::vector<uint8_t>& out, double value)
+{
+    uint8_t bytes[sizeof(double)];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    out.insert(out.end(), bytes, bytes + sizeof(bytes));
+}
+
+bool get_double(const uint8_t*& in, const uint8_t* end, double& value)
+{
+    if (end - in < (ptrdiff_t)sizeof(double))
+        return false;
+    std::memcpy(&value, in, sizeof(double));
+    in += sizeof(double);
+    return true;
+}
+
+}
+
+lineage_writer::~lineage_writer()
+{
+    close();
+}
+
+void lineage_writer::close()
+{
+    if (m_data)
+        fclose(m_data);
+    if (m_index)
+        fclose(m_index);
+    m_data = m_index = nullptr;
+    m_previous.clear();
+}
+
+bool lineage_writer::open(const std::string &path, int keyframe_interval, bool resume)
+{
+    close();
+    m_keyframe_interval = std::max(1, keyframe_interval);
+    m_next_id = m_offset = 0;
+    std::fill(std::begin(m_topology), std::end(m_topology), 0);
+
+    const std::string index_path = path + ".idx";
+    if (resume)
+    {
+        FILE* data  = fopen(path.c_str(), "rb");
+        FILE* index = fopen(index_path.c_str(), "rb");
+        lineage_header header;
+        if (data && index && fread(&header, sizeof(header), 1, data) == 1 && !std::memcmp(header.magic, lineage_magic, sizeof(lineage_magic)))
+        {
+            std::copy(header.topology, header.topology + 4, m_topology);
+            fseek(data, 0, SEEK_END);
+            m_offset = (uint64_t)ftell(data);
+            fseek(index, 0, SEEK_END);
+            m_next_id = (uint64_t)ftell(index) / sizeof(lineage_entry);
+        }
+        else
+            resume = false;
+        if (data)
+            fclose(data);
+        if (index)
+            fclose(index);
+    }
+
+    m_data  = fopen(path.c_str(), resume ? "ab" : "wb");
+    m_index = fopen(index_path.c_str(), resume ? "ab" : "wb");
+    if (!m_data || !m_index)
+    {
+        perror(m_data ? index_path.c_str() : path.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+size_t lineage_writer::closest(const double *weights, size_t count, size_t &differences) const
+{
+    size_t best = m_previous.size();
+    differences = count + 1;
+    for (size_t i { 0 }; i < m_previous.size(); ++i)
+    {
+        const double* other = m_previous[i].weights.data();
+        if (m_previous[i].weights.size() != count)
+            continue;
+
+        // anything beyond the best so far is of no use
+        size_t different = 0;
+        for (size_t w { 0 }; w < count && different < differences; ++w)
+            different += weights[w] != other[w];
+        if (different < differences)
+        {
+            best = i;
+            differences = different;
+            if (different == 0)
+                break;
+        }
+    }
+    return best;
+}
+
+bool lineage_writer::append(int generation, const std::vector<const genann*>& genomes, const std::vector<float>& scores)
+{
+    if (!m_data || genomes.empty())
+        return false;
+
+    if (m_offset == 0)
+    {
+        lineage_header header;
+        std::memcpy(header.magic, lineage_magic, sizeof(lineage_magic));
+        header.topology[0] = genomes[0]->inputs;
+        header.topology[1] = genomes[0]->hidden_layers;
+        header.topology[2] = genomes[0]->hidden;
+        header.topology[3] = genomes[0]->outputs;
+        std::copy(header.topology, header.topology + 4, m_topology);
+        if (fwrite(&header, sizeof(header), 1, m_data) != 1)
+            return false;
+        m_offset = sizeof(header);
+    }
+
+    // best first : the genetic algorithm's parents are met first, and the
+    // search for the nearest ancestor stops early on the others
+    std::vector<size_t> order(genomes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+    { return scores[lhs] > scores[rhs]; });
+
+    m_current.resize(genomes.size());
+    bool written = true;
+    for (size_t rank { 0 }; rank < order.size(); ++rank)
+    {
+        const genann* ann = genomes[order[rank]];
+        const size_t count = ann->total_weights;
+        const size_t whole_size = count * sizeof(double);
+
+        size_t differences;
+        size_t ancestor = closest(ann->weight, count, differences);
+        bool whole = ancestor == m_previous.size() || m_previous[ancestor].depth >= m_keyframe_interval
+                || differences * (1 + sizeof(double)) >= whole_size;
+
+        m_record.clear();
+        put_varint(m_record, order[rank]);
+        if (!whole)
+        {
+            put_varint(m_record, m_next_id - m_previous[ancestor].id);
+            put_varint(m_record, differences);
+            const double* base = m_previous[ancestor].weights.data();
+            size_t last = 0;
+            for (size_t w { 0 }; w < count; ++w)
+            {
+                if (ann->weight[w] == base[w])
+                    continue;
+                put_varint(m_record, w - last);
+                put_double(m_record, ann->weight[w]);
+                last = w;
+            }
+        }
+        else
+        {
+            put_varint(m_record, 0);
+            for (size_t w { 0 }; w < count; ++w)
+                put_double(m_record, ann->weight[w]);
+        }
+
+        lineage_entry entry { m_offset, generation, scores[order[rank]] };
+        written &= fwrite(m_record.data(), 1, m_record.size(), m_data) == m_record.size();
+        written &= fwrite(&entry, sizeof(entry), 1, m_index) == 1;
+        m_offset += m_record.size();
+        m_stored_bytes += m_record.size() + sizeof(entry);
+        m_raw_bytes    += whole_size;
+
+        auto& current = m_current[rank];
+        current.weights.assign(ann->weight, ann->weight + count);
+        current.id    = m_next_id++;
+        current.depth = whole ? 0 : m_previous[ancestor].depth + 1;
+    }
+
+    std::swap(m_previous, m_current);
+    written &= fflush(m_data) == 0;
+    written &= fflush(m_index) == 0;
+    return written;
+}
+
+lineage_reader::~lineage_reader()
+{
+    if (m_data)
+        fclose(m_data);
+}
+
+bool lineage_reader::open(const std::string &path)
+{
+    if (m_data)
+        fclose(m_data);
+    m_entries.clear();
+
+    lineage_header header;
+    m_data = fopen(path.c_str(), "rb");
+    if (!m_data || fread(&header, sizeof(header), 1, m_data) != 1 || std::memcmp(header.magic, lineage_magic, sizeof(lineage_magic)))
+    {
+        fprintf(stderr, "%s: not a lineage store\n", path.c_str());
+        return false;
+    }
+    std::copy(header.topology, header.topology + 4, m_topology);
+    fseek(m_data, 0, SEEK_END);
+    m_data_size = (uint64_t)ftell(m_data);
+
+    const std::string index_path = path + ".idx";
+    FILE* index = fopen(index_path.c_str(), "rb");
+    if (!index)
+    {
+        perror(index_path.c_str());
+        return false;
+    }
+    lineage_entry entry;
+    // entries of records cut short by a crash are dropped
+    while (fread(&entry, sizeof(entry), 1, index) == 1 && entry.offset < m_data_size)
+        m_entries.push_back(entry);
+    fclose(index);
+    return true;
+}
+
+bool lineage_reader::read_record(uint64_t id, std::vector<uint8_t> &record) const
+{
+    if (id >= m_entries.size())
+        return false;
+
+    const uint64_t offset = m_entries[id].offset;
+    const uint64_t end = id + 1 < m_entries.size() ? m_entries[id + 1].offset : m_data_size;
+    record.resize(end - offset);
+    return fseek(m_data, (long)offset, SEEK_SET) == 0 && fread(record.data(), 1, record.size(), m_data) == record.size();
+}
+
+bool lineage_reader::header(uint64_t id, uint64_t &ancestor, uint32_t &field) const
+{
+    std::vector<uint8_t> record;
+    if (!read_record(id, record))
+        return false;
+
+    const uint8_t* in = record.data();
+    const uint8_t* end = in + record.size();
+    uint64_t index, distance;
+    if (!get_varint(in, end, index) || !get_varint(in, end, distance) || distance > id)
+        return false;
+
+    field  = (uint32_t)index;
+    ancestor = distance ? id - distance : no_ancestor;
+    return true;
+}
+
+genann *lineage_reader::load(uint64_t id) const
+{
+    // back to the last whole genome, then its deltas forward
+    std::vector<std::vector<uint8_t>> chain;
+    std::vector<const uint8_t*> bodies;
+    for (uint64_t current { id };;)
+    {
+        chain.emplace_back();
+        if (!read_record(current, chain.back()))
+            return nullptr;
+
+        const uint8_t* in = chain.back().data();
+        const uint8_t* end = in + chain.back().size();
+        uint64_t field, distance;
+        if (!get_varint(in, end, field) || !get_varint(in, end, distance) || distance > current)
+            return nullptr;
+        bodies.push_back(in);
+        if (distance == 0)
+            break;
+        current -= distance;
+    }
+
+    genann* ann = genann_init(m_topology[0], m_topology[1], m_topology[2], m_topology[3]);
+    if (!ann)
+        return nullptr;
+
+    bool valid = true;
+    const uint8_t* in = bodies.back();
+    const uint8_t* end = chain.back().data() + chain.back().size();
+    for (int w { 0 }; w < ann->total_weights && valid; ++w)
+        valid = get_double(in, end, ann->weight[w]);
+
+    for (size_t link { chain.size() - 1 }; link-- > 0 && valid;)
+    {
+        in  = bodies[link];
+        end = chain[link].data() + chain[link].size();
+        uint64_t count, index = 0;
+        valid = get_varint(in, end, count);
+        for (uint64_t i { 0 }; i < count && valid; ++i)
+        {
+            uint64_t gap;
+            valid = get_varint(in, end, gap) && (index += gap) < (uint64_t)ann->total_weights
+                    && get_double(in, end, ann->weight[index]);
+        }
+    }
+
+    if (!valid)
+    {
+        genann_free(ann);
+        return nullptr;
+    }
+    return ann;
+}
@@ -0,0 +1,137 @@
+/*
+lineage.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef LINEAGE_HPP
+#define LINEAGE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "genann.h"
+
+// Where a genome is in a lineage store : fixed size entries of <store>.idx,
+// a genome's id being its position there.
+struct lineage_entry
+{
+    uint64_t offset;     // of its record in the store
+    int32_t  generation;
+    float    score;
+};
+
+const uint64_t no_ancestor = ~0ull;
+
+// Append-only history of every evaluated genome of a run, a generation at a
+// time. A genome is recorded as its nearest ancestor, the closest genome of
+// the previous generation (the fewest differing weights), and the weights
+// that differ from it as (index gap, value) pairs : a child bred by
+// crossover and a mutation costs a few bytes instead of total_weights
+// doubles. The nearest ancestor is a heuristic, not the breeding record :
+// it is usually one of a child's parents, the one it took more genes from,
+// but a child may as well be closest to a sibling of its parents.
+// Genomes without a close ancestor (random immigrants, migrants, samples of
+// the evolution strategies) are stored whole, and so is any genome
+// keyframe_interval deltas away from a whole one, which bounds the work
+// of rebuilding one.
+//
+// Records are written one after the other to the store and their index
+// entries to <store>.idx, both flushed after each generation.
+class lineage_writer
+{
+public:
+    ~lineage_writer();
+
+    // Appends to the store if it exists and `resume` is set (its first
+    // generation from then on being stored whole), else starts it over.
+    bool open(const std::string& path, int keyframe_interval, bool resume);
+    void close();
+
+    bool is_open() const
+    { return m_data != nullptr; }
+
+    // Records a generation's genomes, which all have the store's topology.
+    bool append(int generation, const std::vector<const genann*>& genomes, const std::vector<float>& scores);
+
+    // sizes of the store and index so far, and of the genomes' weights as doubles
+    uint64_t stored_bytes() const
+    { return m_stored_bytes; }
+    uint64_t raw_bytes() const
+    { return m_raw_bytes; }
+
+private:
+    struct genome
+    {
+        std::vector<double> weights;
+        uint64_t id;
+        int depth; // deltas from a whole genome
+    };
+
+    // Index in m_previous of the closest genome to weights, m_previous.size() if none.
+    size_t closest(const double* weights, size_t count, size_t& differences) const;
+
+    FILE* m_data  { nullptr };
+    FILE* m_index { nullptr };
+    int m_keyframe_interval { 256 };
+    int m_topology[4] { 0, 0, 0, 0 }; // inputs, hidden layers, hidden, outputs
+    uint64_t m_next_id { 0 };
+    uint64_t m_offset  { 0 };
+    std::vector<genome> m_previous, m_current; // generations, best score first
+    std::vector<uint8_t> m_record;
+    uint64_t m_stored_bytes { 0 };
+    uint64_t m_raw_bytes    { 0 };
+};
+
+// Random access over a lineage store : the index is read on open, a genome
+// is rebuilt from its last whole ancestor when asked for.
+class lineage_reader
+{
+public:
+    ~lineage_reader();
+
+    // false, with a message on stderr, if path isn't a lineage store
+    bool open(const std::string& path);
+
+    size_t size() const
+    { return m_entries.size(); }
+    const lineage_entry& operator[](uint64_t id) const
+    { return m_entries[id]; }
+
+    // The genome's nearest ancestor (no_ancestor if stored whole) and its
+    // index in its generation.
+    bool header(uint64_t id, uint64_t& ancestor, uint32_t& field) const;
+    // A new net holding the genome, null on a read error.
+    genann* load(uint64_t id) const;
+
+private:
+    bool read_record(uint64_t id, std::vector<uint8_t>& record) const;
+
+    FILE* m_data { nullptr };
+    int m_topology[4] { 0, 0, 0, 0 };
+    uint64_t m_data_size { 0 };
+    std::vector<lineage_entry> m_entries;
+};
+
+#endif // LINEAGE_HPP
@@ -0,0 +1,337 @@
+/*
+matchmaking.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "matchmaking.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "fitness_cache.hpp"
+
+std::vector<pairing> round_robin_pairings(size_t count, size_t first, size_t rounds)
+{
+    std::vector<pairing> pairings;
+    if (count < 2)
+        return pairings;
+
+    const size_t slots = count + count % 2; // with an odd count, the last slot is the bye
+    const size_t cycle = slots - 1;
+    if (rounds == 0 || rounds > cycle)
+        rounds = cycle;
+
+    pairings.reserve(rounds * slots / 2);
+    for (size_t r { 0 }; r < rounds; ++r)
+    {
+        // player 0 stays in place, the others turn around the table
+        const size_t round = (first + r) % cycle;
+        auto seated = [&](size_t position)
+        { return position == 0 ? 0 : (position - 1 + round) % cycle + 1; };
+
+        for (size_t i { 0 }; i < slots / 2; ++i)
+        {
+            size_t a = seated(i), b = seated(slots - 1 - i);
+            if (a < count && b < count)
+                pairings.emplace_back(a, b);
+        }
+    }
+    return pairings;
+}
+
+std::vector<pairing> swiss_pairings(const std::vector<float>& points, const std::vector<char>& met)
+{
+    const size_t count = points.size();
+    std::vector<size_t> ranking(count);
+    std::iota(ranking.begin(), ranking.end(), 0);
+    std::stable_sort(ranking.begin(), ranking.end(), [&](size_t lhs, size_t rhs)
+    { return points[lhs] > points[rhs]; });
+
+    std::vector<pairing> pairings;
+    std::vector<char> paired(count, 0);
+    for (size_t i { 0 }; i < count; ++i)
+    {
+        const size_t a = ranking[i];
+        if (paired[a])
+            continue;
+
+        size_t opponent = count;
+        for (size_t j { i + 1 }; j < count; ++j)
+        {
+            const size_t b = ranking[j];
+            if (paired[b])
+                continue;
+            if (opponent == count)
+                opponent = b;
+            if (!met[a * count + b])
+            {
+                opponent = b;
+                break;
+            }
+        }
+        if (opponent == count)
+            continue;
+
+        paired[a] = paired[opponent] = 1;
+        pairings.emplace_back(a, opponent);
+    }
+    return pairings;
+}
+
+matchmaker::matchmaker(const matchmaking_params &params)
+    : m_params(params)
+{
+    const unsigned threads = std::max(1u, params.threads);
+    if (threads > 1)
+        m_pool.reset(new shard_pool(threads));
+    m_copies.resize(threads);
+    m_engines.assign(threads, pong_duels(params.rules));
+    m_thread_ticks.assign(threads, 0);
+}
+
+matchmaker::~matchmaker()
+{
+    for (auto& copies : m_copies)
+    {
+        for (auto* copy : copies)
+            genann_free(copy);
+    }
+    for (auto* member : m_hall)
+        genann_free(member);
+}
+
+bool matchmaker::known_format(const std::string &format)
+{
+    return format == "round_robin" || format == "swiss" || format == "hall_of_fame";
+}
+
+void matchmaker::play(const std::vector<const genann*>& genomes, int generation, std::vector<float>& scores)
+{
+    const size_t count = genomes.size();
+    scores.assign(count, 0);
+    if (count < 2)
+        return;
+
+    m_genomes = &genomes;
+    m_hashes.resize(count + m_hall.size());
+    for (size_t i { 0 }; i < count; ++i)
+        m_hashes[i] = weights_hash(genomes[i]);
+    std::copy(m_hall_hashes.begin(), m_hall_hashes.end(), m_hashes.begin() + count);
+    m_totals.assign(count, 0);
+    m_counts.assign(count, 0);
+    m_points.assign(count, 0);
+    refresh_copies();
+
+    const size_t cycle  = count + count % 2 - 1;
+    const size_t rounds = m_params.opponents ? std::min(m_params.opponents, cycle) : cycle;
+    const size_t first  = (size_t)generation * rounds % cycle;
+    m_capacity = std::max(m_capacity, 4 * count * rounds);
+
+    if (m_params.format == "swiss")
+    {
+        std::vector<char> met(count * count, 0);
+        for (size_t r { 0 }; r < rounds; ++r)
+        {
+            auto pairings = r == 0 ? round_robin_pairings(count, first, 1) : swiss_pairings(m_points, met);
+            for (const auto& p : pairings)
+                met[p.first * count + p.second] = met[p.second * count + p.first] = 1;
+            play_round(pairings);
+        }
+    }
+    else if (m_params.format == "hall_of_fame" && !m_hall.empty())
+    {
+        const size_t members = m_params.opponents ? std::min(m_params.opponents, m_hall.size()) : m_hall.size();
+        std::vector<pairing> pairings;
+        pairings.reserve(count * members);
+        for (size_t i { 0 }; i < count; ++i)
+        {
+            for (size_t j { 0 }; j < members; ++j)
+                pairings.emplace_back(i, count + m_hall.size() - 1 - j * m_hall.size() / members);
+        }
+        play_round(pairings);
+    }
+    else
+        play_round(round_robin_pairings(count, first, rounds));
+
+    for (size_t i { 0 }; i < count; ++i)
+        scores[i] = m_counts[i] ? m_totals[i] / m_counts[i] : 0.f;
+    for (auto& ticks : m_thread_ticks)
+    {
+        m_ticks += ticks;
+        ticks = 0;
+    }
+
+    if (m_params.format == "hall_of_fame")
+    {
+        size_t champion = std::max_element(scores.begin(), scores.end()) - scores.begin();
+        m_hall.push_back(genann_copy(genomes[champion]));
+        m_hall_hashes.push_back(m_hashes[champion]);
+        while (m_hall.size() > m_params.hall_of_fame)
+        {
+            genann_free(m_hall.front());
+            m_hall.erase(m_hall.begin());
+            m_hall_hashes.erase(m_hall_hashes.begin());
+        }
+    }
+
+    m_genomes = nullptr;
+    ++m_generation;
+}
+
+void matchmaker::play_round(const std::vector<pairing>& pairings)
+{
+    std::vector<pong_duels::match> round(pairings.size());
+    std::vector<size_t> unplayed;
+    for (size_t m { 0 }; m < pairings.size(); ++m)
+    {
+        size_t left = pairings[m].first, right = pairings[m].second;
+        if (m_hashes[right] < m_hashes[left])
+            std::swap(left, right);
+
+        auto& match = round[m];
+        match.left  = left;
+        match.right = right;
+        match.seed  = m_hashes[left] ^ m_hashes[right] * 0x9E3779B97F4A7C15ull ^ m_params.seed;
+        if (!lookup(match, match.score))
+            unplayed.push_back(m);
+    }
+
+    if (!unplayed.empty())
+    {
+        m_pending.clear();
+        for (size_t m : unplayed)
+            m_pending.push_back(round[m]);
+
+        const std::function<void(unsigned)> job = [this](unsigned thread)
+        {
+            const size_t count = m_pending.size(), threads = m_engines.size();
+            const size_t first = count * thread / threads, last = count * (thread + 1) / threads;
+            m_thread_ticks[thread] += m_engines[thread].play(m_pending.data() + first, last - first, m_copies[thread].data());
+        };
+        if (m_pool)
+            m_pool->run(job);
+        else
+            job(0);
+
+        for (size_t j { 0 }; j < unplayed.size(); ++j)
+        {
+            round[unplayed[j]] = m_pending[j];
+            store(m_pending[j]);
+        }
+    }
+
+    const size_t count = m_genomes->size();
+    for (const auto& match : round)
+    {
+        for (int side { 0 }; side < 2; ++side)
+        {
+            const size_t player = side ? match.right : match.left;
+            if (player >= count)
+                continue;
+
+            const float own = match.score[side], other = match.score[1 - side];
+            m_totals[player] += own;
+            ++m_counts[player];
+            m_points[player] += own > other ? 1.f : own == other ? 0.5f : 0.f;
+        }
+    }
+}
+
+bool matchmaker::lookup(const pong_duels::match &m, float *score)
+{
+    const genann* left  = player(m.left);
+    const genann* right = player(m.right);
+    auto found = m_cache.find(m_hashes[m.left] * 0xff51afd7ed558ccdull ^ m_hashes[m.right]);
+    if (found == m_cache.end() || found->second.left != m_hashes[m.left] || found->second.right != m_hashes[m.right]
+            || found->second.weights.size() != (size_t)(left->total_weights + right->total_weights)
+            || !std::equal(left->weight, left->weight + left->total_weights, found->second.weights.begin())
+            || !std::equal(right->weight, right->weight + right->total_weights, found->second.weights.begin() + left->total_weights))
+    {
+        ++m_misses;
+        return false;
+    }
+
+    ++m_hits;
+    found->second.generation = m_generation;
+    score[0] = found->second.score[0];
+    score[1] = found->second.score[1];
+    return true;
+}
+
+void matchmaker::store(const pong_duels::match &m)
+{
+    if (m_cache.size() >= m_capacity)
+    {
+        // entries untouched this generation go first
+        for (auto it = m_cache.begin(); it != m_cache.end();)
+        {
+            if (it->second.generation < m_generation)
+                it = m_cache.erase(it);
+            else
+                ++it;
+        }
+        if (m_cache.size() >= m_capacity)
+            return;
+    }
+
+    const genann* left  = player(m.left);
+    const genann* right = player(m.right);
+    auto& stored = m_cache[m_hashes[m.left] * 0xff51afd7ed558ccdull ^ m_hashes[m.right]];
+    stored.left  = m_hashes[m.left];
+    stored.right = m_hashes[m.right];
+    stored.weights.assign(left->weight, left->weight + left->total_weights);
+    stored.weights.insert(stored.weights.end(), right->weight, right->weight + right->total_weights);
+    stored.score[0] = m.score[0];
+    stored.score[1] = m.score[1];
+    stored.generation = m_generation;
+}
+
+void matchmaker::refresh_copies()
+{
+    const size_t players = m_genomes->size() + m_hall.size();
+    const std::function<void(unsigned)> job = [this, players](unsigned thread)
+    {
+        auto& copies = m_copies[thread];
+        for (size_t i { players }; i < copies.size(); ++i)
+            genann_free(copies[i]);
+        copies.resize(players, nullptr);
+
+        for (size_t i { 0 }; i < players; ++i)
+        {
+            const genann* source = player(i);
+            if (copies[i] && copies[i]->total_weights == source->total_weights)
+                std::memcpy(copies[i]->weight, source->weight, sizeof(double) * source->total_weights);
+            else
+            {
+                if (copies[i])
+                    genann_free(copies[i]);
+                copies[i] = genann_copy(source);
+            }
+        }
+    };
+    if (m_pool)
+        m_pool->run(job);
+    else
+        job(0);
+}
@@ -0,0 +1,141 @@
+/*
+matchmaking.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef MATCHMAKING_HPP
+#define MATCHMAKING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "genann.h"
+#include "pong_duel.hpp"
+#include "shard_pool.hpp"
+
+using pairing = std::pair<size_t, size_t>;
+
+// `rounds` rounds of a round robin between `count` players by the circle
+// method, from round `first` on : count - 1 rounds (all of them if rounds is
+// 0) meet every pair once, an odd count giving a bye to one player per round.
+std::vector<pairing> round_robin_pairings(size_t count, size_t first, size_t rounds);
+
+// One Swiss round : players ranked by points, each paired with the next one
+// it hasn't met yet (met[a * count + b]), or the next one if it met them
+// all. An odd count leaves the last one without a match.
+std::vector<pairing> swiss_pairings(const std::vector<float>& points, const std::vector<char>& met);
+
+struct matchmaking_params
+{
+    std::string format { "round_robin" }; // round_robin, swiss or hall_of_fame
+    size_t   opponents    { 4 };  // matches per genome and generation, 0 for a full round robin
+    size_t   hall_of_fame { 50 }; // past champions kept, hall_of_fame only
+    unsigned threads { 1 };
+    unsigned seed    { 0 };
+    pong_duels::rules rules;
+};
+
+// Scores co-evolving pong genomes by playing them against each other, a
+// generation at a time :
+// - round_robin : `opponents` rounds of a round robin, a different part of it
+//   each generation ;
+// - swiss : `opponents` Swiss rounds, each paired from the previous results ;
+// - hall_of_fame : against `opponents` champions of past generations, spread
+//   over the hall from the latest one. The first generation, which has none,
+//   plays a round robin.
+//
+// A pair always plays the same match (sides and seed follow from the
+// weights), so results are cached per pair : carried over parents,
+// unmutated children and hall members don't replay their matches. The
+// others are split between threads, each with copies of the nets.
+class matchmaker
+{
+public:
+    explicit matchmaker(const matchmaking_params& params);
+    ~matchmaker();
+
+    matchmaker(const matchmaker&) = delete;
+    matchmaker& operator=(const matchmaker&) = delete;
+
+    static bool known_format(const std::string& format);
+
+    // scores[i] is the mean score of genomes[i] over its matches of this
+    // generation. The genomes all have the pong topology.
+    void play(const std::vector<const genann*>& genomes, int generation, std::vector<float>& scores);
+
+    unsigned long long ticks() const
+    { return m_ticks; }
+    unsigned long long hits() const
+    { return m_hits; }
+    unsigned long long misses() const
+    { return m_misses; }
+
+private:
+    struct cached_match
+    {
+        uint64_t left, right;        // weight hashes
+        std::vector<double> weights; // left's then right's
+        float score[2];
+        unsigned long long generation; // last use
+    };
+
+    // Plays the pairings of players (genomes then hall members), adding the
+    // genomes' results to m_totals and m_counts, and the winners' points to m_points.
+    void play_round(const std::vector<pairing>& pairings);
+    bool lookup(const pong_duels::match& m, float* score);
+    void store(const pong_duels::match& m);
+    void refresh_copies();
+
+    const genann* player(size_t index) const
+    { return index < m_genomes->size() ? (*m_genomes)[index] : m_hall[index - m_genomes->size()]; }
+
+    matchmaking_params m_params;
+    std::unique_ptr<shard_pool> m_pool;          // null with one thread
+    std::vector<std::vector<genann*>> m_copies;  // per thread, of every player
+    std::vector<pong_duels> m_engines;           // per thread
+
+    std::vector<genann*> m_hall;     // oldest first
+    std::vector<uint64_t> m_hall_hashes;
+
+    // of the generation being played
+    const std::vector<const genann*>* m_genomes { nullptr };
+    std::vector<uint64_t> m_hashes;  // per player
+    std::vector<double> m_totals;
+    std::vector<size_t> m_counts;
+    std::vector<float>  m_points;
+    std::vector<pong_duels::match> m_pending;
+    std::vector<unsigned long long> m_thread_ticks;
+
+    std::unordered_map<uint64_t, cached_match> m_cache;
+    size_t m_capacity { 0 };
+    unsigned long long m_generation { 0 };
+    unsigned long long m_ticks  { 0 };
+    unsigned long long m_hits   { 0 };
+    unsigned long long m_misses { 0 };
+};
+
+#endif // MATCHMAKING_HPP
@@ -0,0 +1,137 @@
+/*
+mutation.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "mutation.hpp"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "random.hpp"
+
+#include "genann.h"
+
+namespace
+{
+
+// 1/5th rule factor, from Schwefel
+const double one_fifth_factor = 0.82;
+// below it a self-adapted step would never come back
+const double min_step = 1e-6;
+
+// uniform in ]0; 1[, safe to take the log of
+double open_unit(std::mt19937& engine)
+{
+    return (engine() + 0.5) * (1.0 / 4294967296.0);
+}
+
+// Standard normals, Box-Muller on pairs of uniforms drawn beforehand : the
+// engine is the only sequential part, the transform is a pass of its own.
+void fill_normal(std::vector<double>& out, size_t count)
+{
+    auto& engine = random_engine();
+    const size_t pairs = (count + 1) / 2;
+    out.resize(2 * pairs);
+    for (auto& u : out)
+        u = open_unit(engine);
+
+    double* values = out.data();
+    for (size_t i { 0 }; i < pairs; ++i)
+    {
+        const double radius = std::sqrt(-2 * std::log(values[2*i]));
+        const double angle = 2 * M_PI * values[2*i + 1];
+        values[2*i] = radius * std::cos(angle);
+        values[2*i + 1] = radius * std::sin(angle);
+    }
+    out.resize(count);
+}
+
+}
+
+bool known_step_rule(const std::string &rule)
+{
+    return rule == "fixed" || rule == "self_adaptive" || rule == "one_fifth";
+}
+
+neural_net mutate_gaussian(const neural_net &net, double mutation_factor, const mutation_params &params)
+{
+    // no mutation
+    if (random_unit() < mutation_factor)
+        return net;
+
+    neural_net mutated = net;
+    double* weights = mutated.nn->weight;
+    const int count = mutated.nn->total_weights;
+
+    double step = params.sigma;
+    if (params.step_rule == "self_adaptive")
+    {
+        const double tau = 1 / std::sqrt((double)count);
+        step = net.mutation_step > 0 ? net.mutation_step : params.sigma;
+        step = std::max(step * std::exp(tau * random_normal()), min_step);
+        mutated.mutation_step = step;
+    }
+
+    thread_local std::vector<double> noise;
+    if (params.rate >= 1)
+    {
+        fill_normal(noise, count);
+        const double* perturbation = noise.data();
+        for (int i { 0 }; i < count; ++i)
+            weights[i] += weights[i] != 0 ? step * perturbation[i] : 0;
+        return mutated;
+    }
+
+    // gaps between perturbed weights are geometric : -1/log(1 - rate) once,
+    // then a single uniform per perturbed weight
+    thread_local std::vector<int> picked;
+    picked.clear();
+    if (params.rate > 0)
+    {
+        auto& engine = random_engine();
+        const double scale = 1 / std::log1p(-params.rate);
+        for (double i = std::floor(std::log(open_unit(engine)) * scale); i < count;
+             i += 1 + std::floor(std::log(open_unit(engine)) * scale))
+            picked.push_back((int)i);
+    }
+
+    fill_normal(noise, picked.size());
+    const double* perturbation = noise.data();
+    for (size_t k { 0 }; k < picked.size(); ++k)
+    {
+        double& weight = weights[picked[k]];
+        weight += weight != 0 ? step * perturbation[k] : 0;
+    }
+
+    return mutated;
+}
+
+double one_fifth_sigma(double sigma, double success_rate)
+{
+    if (success_rate < 0.2)
+        return std::max(sigma * one_fifth_factor, min_step);
+    if (success_rate > 0.2)
+        return sigma / one_fifth_factor;
+    return sigma;
+}
@@ -0,0 +1,57 @@
+/*
+mutation.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef MUTATION_HPP
+#define MUTATION_HPP
+
+#include <string>
+
+#include "network.hpp"
+
+struct mutation_params
+{
+    bool   gaussian  { false }; // else mutate()'s uniform weight replacement
+    double rate      { 0.05 };  // chance of each weight to be perturbed, 1 for all of them
+    double sigma     { 0.1 };   // standard deviation of a perturbation
+    // fixed : sigma as is ; self_adaptive : every genome carries its own step,
+    // mutated log-normally before its weights ; one_fifth : sigma is set
+    // by the population from the share of children beating their parents
+    std::string step_rule { "fixed" };
+};
+
+bool known_step_rule(const std::string& rule);
+
+// Adds N(0, step²) noise to the weights of net, unless skipped with a
+// probability of mutation_factor (like mutate()). Below a rate of 1 the
+// perturbed weights are found by geometric skips, one draw per perturbed
+// weight rather than per weight. Zero weights are missing connections (see
+// sparse_net) and stay so, as with mutate() : only add_connection() regrows
+// them. Changes net in place.
+neural_net mutate_gaussian(const neural_net& net, double mutation_factor, const mutation_params& params);
+
+// 1/5th success rule : the sigma for the next generation, given the share of
+// children that did better than the parents' generation.
+double one_fifth_sigma(double sigma, double success_rate);
+
+#endif // MUTATION_HPP
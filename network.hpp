@@ -32,6 +32,7 @@ struct neural_net
     genann* nn { nullptr };
     double* inputs { nullptr };
     const double* outputs { nullptr };
+    double mutation_step { 0 }; // self-adaptive gaussian mutation's own step, 0 until it has one
 };
 
 void nn_init(neural_net &net, int inputs, int hidden_layers, int hidden_neurons, int outputs);
@@ -0,0 +1,231 @@
+/*
+novelty.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "novelty.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+namespace
+{
+
+const size_t pending_capacity = 32; // brute force below that
+const size_t leaf_size = 8;
+
+float squared_distance(const float* a, const float* b, int dimension)
+{
+    float sum = 0;
+    for (int i { 0 }; i < dimension; ++i)
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+    return sum;
+}
+
+bool by_distance(const std::pair<float, size_t>& lhs, const std::pair<float, size_t>& rhs)
+{
+    return lhs < rhs;
+}
+
+void offer(kd_tree::neighbours& found, size_t k, float distance, size_t index)
+{
+    if (found.size() < k)
+    {
+        found.emplace_back(distance, index);
+        std::push_heap(found.begin(), found.end(), by_distance);
+    }
+    else if (distance < found.front().first)
+    {
+        std::pop_heap(found.begin(), found.end(), by_distance);
+        found.back() = { distance, index };
+        std::push_heap(found.begin(), found.end(), by_distance);
+    }
+}
+
+}
+
+kd_tree::kd_tree(std::vector<float> points, int dimension)
+    : m_dimension(dimension)
+{
+    const size_t count = points.size() / dimension;
+    std::vector<size_t> order(count);
+    for (size_t i { 0 }; i < count; ++i)
+        order[i] = i;
+    m_axis.assign(count, 0);
+
+    build(0, count, order, points);
+
+    m_points.resize(points.size());
+    for (size_t i { 0 }; i < count; ++i)
+        std::copy(&points[order[i] * dimension], &points[order[i] * dimension] + dimension, &m_points[i * dimension]);
+}
+
+void kd_tree::build(size_t begin, size_t end, std::vector<size_t> &order, const std::vector<float> &points)
+{
+    if (end - begin <= leaf_size)
+        return;
+
+    // split on the widest axis of the range
+    int axis = 0;
+    float widest = -1;
+    for (int d { 0 }; d < m_dimension; ++d)
+    {
+        float low = points[order[begin] * m_dimension + d], high = low;
+        for (size_t i { begin + 1 }; i < end; ++i)
+        {
+            low  = std::min(low,  points[order[i] * m_dimension + d]);
+            high = std::max(high, points[order[i] * m_dimension + d]);
+        }
+        if (high - low > widest)
+        {
+            widest = high - low;
+            axis = d;
+        }
+    }
+
+    size_t middle = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](size_t lhs, size_t rhs)
+    { return points[lhs * m_dimension + axis] < points[rhs * m_dimension + axis]; });
+    m_axis[middle] = (unsigned char)axis;
+
+    build(begin, middle, order, points);
+    build(middle + 1, end, order, points);
+}
+
+void kd_tree::nearest(const float *query, size_t k, neighbours &found) const
+{
+    if (k && size())
+        search(0, size(), query, k, found);
+}
+
+void kd_tree::search(size_t begin, size_t end, const float *query, size_t k, neighbours &found) const
+{
+    if (end - begin <= leaf_size)
+    {
+        for (size_t i { begin }; i < end; ++i)
+            offer(found, k, squared_distance(query, &m_points[i * m_dimension], m_dimension), i);
+        return;
+    }
+
+    size_t middle = (begin + end) / 2;
+    const float* split = &m_points[middle * m_dimension];
+    offer(found, k, squared_distance(query, split, m_dimension), middle);
+
+    float offset = query[m_axis[middle]] - split[m_axis[middle]];
+    bool left_first = offset < 0;
+    if (left_first)
+        search(begin, middle, query, k, found);
+    else
+        search(middle + 1, end, query, k, found);
+
+    if (found.size() < k || offset * offset < found.front().first)
+    {
+        if (left_first)
+            search(middle + 1, end, query, k, found);
+        else
+            search(begin, middle, query, k, found);
+    }
+}
+
+novelty_archive::novelty_archive(int dimension)
+    : m_dimension(dimension)
+{
+}
+
+void novelty_archive::add(const float *behaviour)
+{
+    m_pending.insert(m_pending.end(), behaviour, behaviour + m_dimension);
+    if (m_pending.size() < pending_capacity * m_dimension)
+        return;
+
+    // binary counter : carry the points up to the first empty level
+    std::vector<float> carry;
+    carry.swap(m_pending);
+    size_t level = 0;
+    for (; level < m_trees.size() && m_trees[level].size(); ++level)
+    {
+        const auto& points = m_trees[level].points();
+        carry.insert(carry.end(), points.begin(), points.end());
+        m_trees[level] = kd_tree();
+    }
+    if (level == m_trees.size())
+        m_trees.emplace_back();
+    m_trees[level] = kd_tree(std::move(carry), m_dimension);
+}
+
+size_t novelty_archive::size() const
+{
+    size_t total = m_pending.size() / m_dimension;
+    for (const auto& tree : m_trees)
+        total += tree.size();
+    return total;
+}
+
+void novelty_archive::nearest(const float *query, size_t k, kd_tree::neighbours &found) const
+{
+    // indices are meaningless across trees, only the distances matter here
+    for (const auto& tree : m_trees)
+        tree.nearest(query, k, found);
+    for (size_t i { 0 }; i < m_pending.size() / m_dimension; ++i)
+        offer(found, k, squared_distance(query, &m_pending[i * m_dimension], m_dimension), i);
+}
+
+std::vector<float> novelty_scores(const novelty_archive &archive, const std::vector<float> &behaviours, int dimension,
+                                  size_t k, unsigned threads)
+{
+    const size_t count = behaviours.size() / dimension;
+    std::vector<float> novelty(count, 0.f);
+
+    auto score_range = [&](size_t begin, size_t end)
+    {
+        kd_tree::neighbours found;
+        for (size_t i { begin }; i < end; ++i)
+        {
+            const float* query = &behaviours[i * dimension];
+            found.clear();
+            archive.nearest(query, k, found);
+            // the generation itself is small, brute force is fine
+            for (size_t j { 0 }; j < count; ++j)
+            {
+                if (j != i)
+                    offer(found, k, squared_distance(query, &behaviours[j * dimension], dimension), j);
+            }
+
+            float total = 0;
+            for (const auto& neighbour : found)
+                total += std::sqrt(neighbour.first);
+            novelty[i] = found.empty() ? 0.f : total / found.size();
+        }
+    };
+
+    threads = std::max(1u, std::min<unsigned>(threads, (unsigned)count));
+    std::vector<std::future<void>> tasks;
+    for (unsigned t { 1 }; t < threads; ++t)
+        tasks.push_back(std::async(std::launch::async, score_range, count * t / threads, count * (t + 1) / threads));
+    score_range(0, count / threads);
+    for (auto& task : tasks)
+        task.get();
+
+    return novelty;
+}
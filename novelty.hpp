@@ -0,0 +1,87 @@
+/*
+novelty.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef NOVELTY_HPP
+#define NOVELTY_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Static kd-tree over points of a fixed dimension, stored implicitly : the
+// points are reordered so that the median of every range splits it.
+class kd_tree
+{
+public:
+    // (squared distance, point index) pairs, a max-heap on the distance
+    using neighbours = std::vector<std::pair<float, size_t>>;
+
+    kd_tree() = default;
+    kd_tree(std::vector<float> points, int dimension);
+
+    size_t size() const
+    { return m_dimension ? m_points.size() / m_dimension : 0; }
+    const std::vector<float>& points() const
+    { return m_points; }
+
+    // Merges the points closer than the current k-th into `found`, at most k kept.
+    void nearest(const float* query, size_t k, neighbours& found) const;
+
+private:
+    void build(size_t begin, size_t end, std::vector<size_t>& order, const std::vector<float>& points);
+    void search(size_t begin, size_t end, const float* query, size_t k, neighbours& found) const;
+
+    int m_dimension { 0 };
+    std::vector<float> m_points;    // reordered
+    std::vector<unsigned char> m_axis; // split axis of the range whose median is at that index
+};
+
+// Behaviours seen so far, for novelty search. Insertions go to a small
+// buffer which is merged into kd-trees of doubling sizes (logarithmic
+// method), so a tree is only ever rebuilt with twice as many points and no
+// insertion costs a rebuild of the whole archive. Queries are read only and
+// can run concurrently.
+class novelty_archive
+{
+public:
+    explicit novelty_archive(int dimension);
+
+    void add(const float* behaviour);
+    size_t size() const;
+
+    void nearest(const float* query, size_t k, kd_tree::neighbours& found) const;
+
+private:
+    int m_dimension;
+    std::vector<float> m_pending;
+    std::vector<kd_tree> m_trees; // m_trees[i] is empty or holds pending_capacity << i points
+};
+
+// Novelty of each behaviour (a row of `behaviours`) : its mean distance to
+// its k nearest neighbours among the archive and the other behaviours of
+// its generation. Queries are split over `threads` threads.
+std::vector<float> novelty_scores(const novelty_archive& archive, const std::vector<float>& behaviours, int dimension,
+                                  size_t k, unsigned threads);
+
+#endif // NOVELTY_HPP
@@ -0,0 +1,182 @@
+/*
+pareto.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "pareto.hpp"
+
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <numeric>
+
+namespace
+{
+
+// concurrent objective sorts only pay off past this many points
+const size_t parallel_threshold = 2048;
+
+bool dominates(const float* a, const float* b, int dimension)
+{
+    bool better = false;
+    for (int m { 0 }; m < dimension; ++m)
+    {
+        if (a[m] < b[m])
+            return false;
+        better |= a[m] > b[m];
+    }
+    return better;
+}
+
+}
+
+void non_dominated_sort(const std::vector<float> &objectives, int dimension, const std::vector<float> *violation,
+                        std::vector<int> &front)
+{
+    const size_t count = objectives.size() / dimension;
+    front.assign(count, 0);
+
+    std::vector<size_t> feasible, infeasible;
+    for (size_t i { 0 }; i < count; ++i)
+    {
+        if (violation && (*violation)[i] > 0)
+            infeasible.push_back(i);
+        else
+            feasible.push_back(i);
+    }
+
+    // lexicographically decreasing : a dominating point always comes first
+    std::sort(feasible.begin(), feasible.end(), [&](size_t lhs, size_t rhs)
+    {
+        const float* a = &objectives[lhs * dimension];
+        const float* b = &objectives[rhs * dimension];
+        for (int m { 0 }; m < dimension; ++m)
+        {
+            if (a[m] != b[m])
+                return a[m] > b[m];
+        }
+        return lhs < rhs;
+    });
+
+    std::vector<std::vector<size_t>> fronts;
+    auto dominated_in = [&](size_t f, size_t point)
+    {
+        // the latest members are the closest in order, so the likeliest dominators
+        const auto& members = fronts[f];
+        for (auto it = members.rbegin(); it != members.rend(); ++it)
+        {
+            if (dominates(&objectives[*it * dimension], &objectives[point * dimension], dimension))
+                return true;
+        }
+        return false;
+    };
+
+    for (size_t point : feasible)
+    {
+        // a point dominated in front f is dominated in every front before f
+        size_t low = 0, high = fronts.size();
+        while (low < high)
+        {
+            size_t middle = (low + high) / 2;
+            if (dominated_in(middle, point))
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        if (low == fronts.size())
+            fronts.emplace_back();
+        fronts[low].push_back(point);
+        front[point] = (int)low;
+    }
+
+    std::stable_sort(infeasible.begin(), infeasible.end(), [violation](size_t lhs, size_t rhs)
+    { return (*violation)[lhs] < (*violation)[rhs]; });
+    int rank = (int)fronts.size() - 1;
+    for (size_t i { 0 }; i < infeasible.size(); ++i)
+    {
+        if (i == 0 || (*violation)[infeasible[i]] != (*violation)[infeasible[i-1]])
+            ++rank;
+        front[infeasible[i]] = rank;
+    }
+}
+
+void crowding_distance(const std::vector<float> &objectives, int dimension, const std::vector<int> &front,
+                       std::vector<float> &distance)
+{
+    const size_t count = front.size();
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    // each objective's share of every point's distance
+    auto share = [&](int m)
+    {
+        std::vector<float> gaps(count, 0.f);
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+        {
+            if (front[lhs] != front[rhs])
+                return front[lhs] < front[rhs];
+            float a = objectives[lhs * dimension + m], b = objectives[rhs * dimension + m];
+            return a != b ? a < b : lhs < rhs;
+        });
+
+        for (size_t begin { 0 }, end; begin < count; begin = end)
+        {
+            for (end = begin + 1; end < count && front[order[end]] == front[order[begin]]; ++end)
+                ;
+
+            const float low  = objectives[order[begin] * dimension + m];
+            const float high = objectives[order[end - 1] * dimension + m];
+            gaps[order[begin]] = gaps[order[end - 1]] = infinity;
+            if (high == low)
+                continue;
+            for (size_t i { begin + 1 }; i + 1 < end; ++i)
+                gaps[order[i]] = (objectives[order[i + 1] * dimension + m] - objectives[order[i - 1] * dimension + m]) / (high - low);
+        }
+        return gaps;
+    };
+
+    std::vector<std::vector<float>> shares(dimension);
+    if (count >= parallel_threshold && dimension > 1)
+    {
+        std::vector<std::future<std::vector<float>>> tasks;
+        for (int m { 0 }; m < dimension; ++m)
+            tasks.push_back(std::async(std::launch::async, share, m));
+        for (int m { 0 }; m < dimension; ++m)
+            shares[m] = tasks[m].get();
+    }
+    else
+    {
+        for (int m { 0 }; m < dimension; ++m)
+            shares[m] = share(m);
+    }
+
+    // summed in a fixed order, whatever ran concurrently
+    distance.assign(count, 0.f);
+    for (const auto& gaps : shares)
+    {
+        for (size_t i { 0 }; i < count; ++i)
+            distance[i] += gaps[i];
+    }
+}
@@ -0,0 +1,53 @@
+/*
+pareto.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef PARETO_HPP
+#define PARETO_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Points are `dimension` objectives, all maximized, stored row after row in
+// `objectives`. A point dominates another if it is at least as good on every
+// objective and better on one.
+
+// Splits count points into non-dominated fronts : front[i] is 0 for the points
+// nobody dominates, 1 for those only dominated by front 0 and so on. Uses the
+// efficient non-dominated sort (Zhang et al., binary search variant) : points
+// are taken in lexicographic order, so that no point can be dominated by a
+// later one, and each is placed in the first front none of whose members
+// dominates it.
+// If violation is not null, points with a positive violation come after all
+// the others, ranked by violation alone (constrained domination).
+void non_dominated_sort(const std::vector<float>& objectives, int dimension, const std::vector<float>* violation,
+                        std::vector<int>& front);
+
+// Crowding distance of every point within its front : the sum over the
+// objectives of the normalized gap between its two neighbours, infinite on
+// the edges of a front. The objectives are sorted concurrently for large
+// populations, the result does not depend on it.
+void crowding_distance(const std::vector<float>& objectives, int dimension, const std::vector<int>& front,
+                       std::vector<float>& distance);
+
+#endif // PARETO_HPP
@@ -28,15 +28,46 @@ SOFTWARE.
 #include <SFML/Graphics/Drawable.hpp>
 #include <SFML/Graphics/Transformable.hpp>
 
+#include <algorithm>
+#include <limits>
+
 #include "network.hpp"
+#include "scenario_bank.hpp"
+#include "sparse_net.hpp"
+#include "blocked_net.hpp"
 
 class PlayField : public sf::Drawable, public sf::Transformable
 {
 public:
-    virtual void  reset() = 0;
+    virtual void  reset() = 0;   // new random net, then restart()
+    virtual void  restart() = 0; // new episode, same net
     virtual void  update(float dt) = 0;
     virtual void  draw(sf::RenderTarget& target, sf::RenderStates states) const = 0;
     virtual float score() const = 0;
+    // Best final score still reachable from the current state.
+    virtual float score_upper_bound() const
+    { return std::numeric_limits<float>::infinity(); }
+    // The episode's outcome as separate objectives, all maximized, for
+    // multi-objective selection. score() alone by default.
+    virtual int   objective_count() const
+    { return 1; }
+    virtual void  objectives(float* values) const
+    { values[0] = score(); }
+    // How far the outcome is from an acceptable one, 0 if it is : any
+    // acceptable episode beats every unacceptable one.
+    virtual float violation() const
+    { return 0; }
+    // Where the episode ended up, for novelty search : comparable values of
+    // similar ranges, 0 of them if the environment has no such notion.
+    virtual int   behaviour_size() const
+    { return 0; }
+    virtual void  behaviour(float* values) const
+    { (void)values; }
+    // True if an episode only depends on the net, so that its score can be reused.
+    virtual bool  deterministic() const
+    { return false; }
+    // Ends the episode right away with a score known from a previous one.
+    virtual void  finish(float score) = 0;
 
     virtual void set_playing(bool val)
             { m_playing = val;  }
@@ -46,8 +77,58 @@ public:
 public:
     neural_net net;
 
+    // network topology and episode length, applied on reset()
+    int   hidden_layers  { 1 };
+    int   hidden_neurons { 4 };
+    float time_limit     { 0 }; // seconds, 0 for no limit
+
+    // control and physics rates : the net is queried every action_repeat
+    // updates, its action held in between, and each update integrates the
+    // physics in physics_substeps steps
+    int   action_repeat    { 1 };
+    int   physics_substeps { 1 };
+
+    // start state of the episodes from the next restart() on, the
+    // environment's own if null
+    const scenario* start { nullptr };
+
+    // query the net through its sparse compilation, or its repacking for wide
+    // layers, which the owner keeps up to date with compile_net() whenever
+    // the weights change
+    bool  sparse_inference  { false };
+    bool  blocked_inference { false };
+    void  compile_net()
+    {
+        if (sparse_inference)
+            m_sparse.compile(net.nn);
+        else if (blocked_inference)
+            m_blocked.compile(net.nn);
+    }
+
+    // True if the next update queries the net.
+    bool control_due() const
+    { return m_update_count % std::max(action_repeat, 1) == 0; }
+
 protected:
+    // Runs the net on net.inputs, setting net.outputs.
+    void run_net()
+    {
+        if (sparse_inference)
+            net.outputs = m_sparse.run(net.inputs);
+        else if (blocked_inference)
+            net.outputs = m_blocked.run(net.inputs);
+        else
+            nn_run(net);
+    }
+
+    // True on the updates that query the net. restart() sets m_update_count back to 0.
+    bool control_tick()
+    { bool due = control_due(); ++m_update_count; return due; }
+
     bool m_playing { false };
+    int  m_update_count { 0 };
+    sparse_net  m_sparse;
+    blocked_net m_blocked;
 };
 
 #endif // PLAYFIELD_HPP
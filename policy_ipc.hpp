@@ -0,0 +1,125 @@
+/*
+policy_ipc.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef POLICY_IPC_HPP
+#define POLICY_IPC_HPP
+
+// Wire formats of the policy server, shared with its clients. Header only so
+// that a simulator can talk to the server without linking any training code.
+//
+// Unix socket : on connect the server sends a handshake, then every request is
+// `inputs` doubles and is answered by `outputs` doubles, in order. Requests
+// may be pipelined.
+//
+// Shared memory : a ring of slots, each one going through
+//   seq == ticket       free, owned by the producer holding that ticket
+//   seq == ticket + 1   request written, waiting for the server
+//   seq == ticket + 2   response written, waiting for the producer
+// and back to ticket + slot_count once the producer has read the response.
+// Those states only stay apart from the next ticket's free one with at least
+// min_slots slots.
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+namespace policy_ipc
+{
+
+const uint32_t magic      = 0x53504e4e; // "NNPS"
+const int      max_values = 32;         // per request, inputs or outputs
+const uint32_t min_slots  = 3;          // see the slot states above
+
+struct handshake
+{
+    uint32_t magic;
+    uint32_t inputs;
+    uint32_t outputs;
+};
+
+struct alignas(64) ring_slot
+{
+    std::atomic<uint64_t> seq;
+    uint64_t submit_ns; // client clock, for end to end latency
+    double   inputs [max_values];
+    double   outputs[max_values];
+};
+
+struct ring_header
+{
+    uint32_t magic;
+    uint32_t inputs;
+    uint32_t outputs;
+    uint32_t slot_count;
+    alignas(64) std::atomic<uint64_t> next_ticket;
+    alignas(64) ring_slot slots[1]; // slot_count long
+};
+
+inline size_t ring_size(uint32_t slot_count)
+{
+    return sizeof(ring_header) + sizeof(ring_slot) * (slot_count - 1);
+}
+
+inline uint64_t now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Spins first, then yields so that an oversubscribed machine keeps progressing.
+inline void wait_for(const std::atomic<uint64_t>& seq, uint64_t value)
+{
+    for (unsigned spins { 0 }; seq.load(std::memory_order_acquire) != value; ++spins)
+    {
+        if (spins > 1000)
+            std::this_thread::yield();
+    }
+}
+
+// Blocking request through the ring, usable from any number of threads or
+// processes mapping the same segment.
+inline void ring_call(ring_header* ring, const double* inputs, double* outputs)
+{
+    uint64_t ticket = ring->next_ticket.fetch_add(1, std::memory_order_relaxed);
+    ring_slot& slot = ring->slots[ticket % ring->slot_count];
+
+    wait_for(slot.seq, ticket);
+
+    for (uint32_t i { 0 }; i < ring->inputs; ++i)
+        slot.inputs[i] = inputs[i];
+    slot.submit_ns = now_ns();
+    slot.seq.store(ticket + 1, std::memory_order_release);
+
+    wait_for(slot.seq, ticket + 2);
+
+    for (uint32_t i { 0 }; i < ring->outputs; ++i)
+        outputs[i] = slot.outputs[i];
+    slot.seq.store(ticket + ring->slot_count, std::memory_order_release);
+}
+
+}
+
+#endif // POLICY_IPC_HPP
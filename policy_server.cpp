@@ -0,0 +1,434 @@
+/*
+policy_server.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+// Standalone inference daemon for a trained champion (see checkpoint_dir in
+// experiment.hpp). Only links genann; protocols are described in policy_ipc.hpp.
+//
+//   NeuralNetworkPolicyServer <champion.net> [--socket path] [--shm name] [--slots n]
+//                             [--max-batch n] [--threads n] [--stats seconds]
+//
+// Requests arriving together, from any client and either transport, are
+// served as one batch (at most --max-batch of them taken from the ring per
+// round, so that sockets are not starved). Nets with wide enough layers run
+// each batch as one blocked_net pass, --threads splitting its widest
+// layers. Latency percentiles are printed on stderr every --stats seconds
+// and on exit.
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "blocked_net.hpp"
+#include "genann.h"
+#include "policy_ipc.hpp"
+
+namespace
+{
+
+volatile std::sig_atomic_t running = 1;
+
+void stop(int)
+{
+    running = 0;
+}
+
+// Log-linear histogram : 16 sub-buckets per power of two, ~6% resolution.
+class latency_histogram
+{
+public:
+    void record(uint64_t ns)
+    {
+        ++m_buckets[bucket(ns)];
+        ++m_count;
+    }
+
+    uint64_t count() const
+    { return m_count; }
+
+    uint64_t percentile(double p) const
+    {
+        uint64_t rank = (uint64_t)(p * m_count);
+        uint64_t seen = 0;
+        for (int i { 0 }; i < bucket_count; ++i)
+        {
+            seen += m_buckets[i];
+            if (seen > rank)
+                return lower_bound(i);
+        }
+        return 0;
+    }
+
+    void clear()
+    {
+        std::memset(m_buckets, 0, sizeof(m_buckets));
+        m_count = 0;
+    }
+
+private:
+    static const int bucket_count = 64*16;
+
+    static int bucket(uint64_t v)
+    {
+        if (v < 16)
+            return (int)v;
+        int exponent = 63 - __builtin_clzll(v);
+        return (exponent - 3) * 16 + (int)((v >> (exponent - 4)) & 15);
+    }
+    static uint64_t lower_bound(int bucket)
+    {
+        if (bucket < 16)
+            return bucket;
+        int exponent = bucket / 16 + 3;
+        return (uint64_t)(16 + bucket % 16) << (exponent - 4);
+    }
+
+    uint64_t m_buckets[bucket_count] {};
+    uint64_t m_count { 0 };
+};
+
+struct client
+{
+    std::string in;
+    std::string out;
+};
+
+struct request
+{
+    int      fd;   // -1 for ring requests
+    policy_ipc::ring_slot* slot;
+    const double* inputs;
+    uint64_t received_ns;
+};
+
+bool flush(int fd, client& c)
+{
+    while (!c.out.empty())
+    {
+        ssize_t written = send(fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (written < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        c.out.erase(0, written);
+    }
+    return true;
+}
+
+int usage()
+{
+    fprintf(stderr, "usage: NeuralNetworkPolicyServer <champion.net> [--socket path] [--shm name] [--slots n] [--max-batch n] [--threads n] [--stats seconds]\n");
+    return EXIT_FAILURE;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string genome_path;
+    std::string socket_path = "/tmp/nn_policy.sock";
+    std::string shm_name;
+    uint32_t slot_count = 256;
+    size_t   max_batch  = 64;
+    unsigned threads    = 1;
+    double   stats_interval = 5;
+
+    for (int i { 1 }; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--socket") && i+1 < argc)
+            socket_path = argv[++i];
+        else if (!strcmp(argv[i], "--shm") && i+1 < argc)
+            shm_name = argv[++i];
+        else if (!strcmp(argv[i], "--slots") && i+1 < argc)
+        {
+            int slots = std::atoi(argv[++i]);
+            if (slots < (int)policy_ipc::min_slots)
+            {
+                fprintf(stderr, "--slots needs at least %u slots\n", policy_ipc::min_slots);
+                return usage();
+            }
+            slot_count = (uint32_t)slots;
+        }
+        else if (!strcmp(argv[i], "--max-batch") && i+1 < argc)
+            max_batch = (size_t)std::max(1, std::atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--threads") && i+1 < argc)
+            threads = (unsigned)std::max(1, std::atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--stats") && i+1 < argc)
+            stats_interval = std::atof(argv[++i]);
+        else if (genome_path.empty())
+            genome_path = argv[i];
+        else
+            return usage();
+    }
+    if (genome_path.empty())
+        return usage();
+
+    FILE* genome_file = fopen(genome_path.c_str(), "r");
+    if (!genome_file)
+    {
+        perror(genome_path.c_str());
+        return EXIT_FAILURE;
+    }
+    genann* ann = genann_read(genome_file);
+    fclose(genome_file);
+    if (!ann)
+        return EXIT_FAILURE;
+    if (ann->inputs > policy_ipc::max_values || ann->outputs > policy_ipc::max_values)
+    {
+        fprintf(stderr, "network too wide for the ipc slots (%d inputs, %d outputs)\n", ann->inputs, ann->outputs);
+        return EXIT_FAILURE;
+    }
+
+    const size_t request_size  = sizeof(double) * ann->inputs;
+    const size_t response_size = sizeof(double) * ann->outputs;
+
+    // below two tiles per layer the padding costs more than the tiling saves
+    std::unique_ptr<blocked_net> blocked;
+    std::vector<double> batch_inputs;
+    if (ann->hidden >= 2 * blocked_net::tile_rows)
+    {
+        blocked.reset(new blocked_net(threads));
+        blocked->compile(ann);
+    }
+
+    // Unix socket
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (listener < 0 || bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 64) < 0)
+    {
+        perror(socket_path.c_str());
+        return EXIT_FAILURE;
+    }
+
+    int poller = epoll_create1(0);
+    epoll_event event {};
+    event.events  = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event);
+
+    // Shared memory ring
+    policy_ipc::ring_header* ring = nullptr;
+    if (!shm_name.empty())
+    {
+        int shm = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0600);
+        size_t size = policy_ipc::ring_size(slot_count);
+        void* memory = MAP_FAILED;
+        if (shm >= 0 && ftruncate(shm, size) == 0)
+            memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+        if (shm >= 0)
+            close(shm);
+        if (memory == MAP_FAILED)
+        {
+            perror(shm_name.c_str());
+            return EXIT_FAILURE;
+        }
+
+        ring = static_cast<policy_ipc::ring_header*>(memory);
+        new (&ring->next_ticket) std::atomic<uint64_t>(0);
+        for (uint32_t i { 0 }; i < slot_count; ++i)
+            new (&ring->slots[i].seq) std::atomic<uint64_t>(i);
+        ring->inputs     = ann->inputs;
+        ring->outputs    = ann->outputs;
+        ring->slot_count = slot_count;
+        std::atomic_thread_fence(std::memory_order_release);
+        ring->magic      = policy_ipc::magic;
+    }
+    uint64_t ring_cursor = 0;
+
+    signal(SIGINT,  stop);
+    signal(SIGTERM, stop);
+
+    std::map<int, client> clients;
+    std::vector<request> batch;
+    batch.reserve(max_batch);
+
+    latency_histogram latencies;
+    uint64_t batches = 0;
+    uint64_t last_report = policy_ipc::now_ns();
+    unsigned idle_rounds = 0;
+
+    auto report = [&]
+    {
+        if (!latencies.count())
+            return;
+        fprintf(stderr, "%llu requests, mean batch %.2f, p50 %.2fus, p99 %.2fus, p99.9 %.2fus\n",
+                (unsigned long long)latencies.count(), (double)latencies.count() / batches,
+                latencies.percentile(0.5) / 1000.0, latencies.percentile(0.99) / 1000.0, latencies.percentile(0.999) / 1000.0);
+        latencies.clear();
+        batches = 0;
+    };
+
+    fprintf(stderr, "serving %s (%d inputs, %d outputs) on %s%s%s\n", genome_path.c_str(), ann->inputs, ann->outputs,
+            socket_path.c_str(), ring ? " and shm " : "", shm_name.c_str());
+
+    while (running)
+    {
+        batch.clear();
+
+        // When the ring is in use the loop spins to keep its latency in the
+        // microseconds, and only backs off after a while without requests.
+        int timeout = ring ? (idle_rounds > 100000 ? 1 : 0) : 100;
+
+        epoll_event events[64];
+        int ready = epoll_wait(poller, events, 64, timeout);
+        uint64_t received = policy_ipc::now_ns();
+
+        for (int e { 0 }; e < ready; ++e)
+        {
+            int fd = events[e].data.fd;
+            if (fd == listener)
+            {
+                int accepted;
+                while ((accepted = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0)
+                {
+                    epoll_event client_event {};
+                    client_event.events  = EPOLLIN | EPOLLOUT | EPOLLET;
+                    client_event.data.fd = accepted;
+                    epoll_ctl(poller, EPOLL_CTL_ADD, accepted, &client_event);
+
+                    policy_ipc::handshake hello { policy_ipc::magic, (uint32_t)ann->inputs, (uint32_t)ann->outputs };
+                    clients[accepted].out.assign((const char*)&hello, sizeof(hello));
+                    flush(accepted, clients[accepted]);
+                }
+                continue;
+            }
+
+            auto& c = clients[fd];
+            bool alive = flush(fd, c);
+            char buffer[4096];
+            ssize_t count = -1;
+            while (alive && (count = recv(fd, buffer, sizeof(buffer), 0)) != 0)
+            {
+                if (count < 0)
+                {
+                    alive = errno == EAGAIN || errno == EWOULDBLOCK;
+                    break;
+                }
+                c.in.append(buffer, count);
+            }
+            if (!alive || count == 0)
+            {
+                epoll_ctl(poller, EPOLL_CTL_DEL, fd, nullptr);
+                close(fd);
+                clients.erase(fd);
+            }
+        }
+
+        // Socket requests, each complete frame is one request
+        for (auto& entry : clients)
+        {
+            const auto& in = entry.second.in;
+            for (size_t offset { 0 }; offset + request_size <= in.size(); offset += request_size)
+                batch.push_back({entry.first, nullptr, (const double*)(in.data() + offset), received});
+        }
+
+        // Ring requests, in ticket order
+        while (ring && batch.size() < max_batch)
+        {
+            auto& slot = ring->slots[ring_cursor % slot_count];
+            if (slot.seq.load(std::memory_order_acquire) != ring_cursor + 1)
+                break;
+            batch.push_back({-1, &slot, slot.inputs, slot.submit_ns});
+            ++ring_cursor;
+        }
+
+        idle_rounds = batch.empty() ? idle_rounds + 1 : 0;
+        if (idle_rounds > 1000)
+            sched_yield();
+
+        const double* batch_outputs = nullptr;
+        if (blocked && !batch.empty())
+        {
+            batch_inputs.resize(batch.size() * ann->inputs);
+            for (size_t i { 0 }; i < batch.size(); ++i)
+                std::memcpy(batch_inputs.data() + i * ann->inputs, batch[i].inputs, request_size);
+            batch_outputs = blocked->run_batch(batch_inputs.data(), batch.size());
+        }
+
+        for (size_t i { 0 }; i < batch.size(); ++i)
+        {
+            const auto& req = batch[i];
+            const double* outputs = blocked ? batch_outputs + i * ann->outputs : genann_run(ann, req.inputs);
+
+            if (req.slot)
+            {
+                std::memcpy(req.slot->outputs, outputs, response_size);
+                uint64_t seq = req.slot->seq.load(std::memory_order_relaxed);
+                req.slot->seq.store(seq + 1, std::memory_order_release);
+            }
+            else
+                clients[req.fd].out.append((const char*)outputs, response_size);
+
+            latencies.record(policy_ipc::now_ns() - req.received_ns);
+        }
+        if (!batch.empty())
+            ++batches;
+
+        for (auto& entry : clients)
+        {
+            auto& c = entry.second;
+            c.in.erase(0, c.in.size() - c.in.size() % request_size);
+            flush(entry.first, c);
+        }
+
+        if (stats_interval > 0 && policy_ipc::now_ns() - last_report > stats_interval * 1e9)
+        {
+            report();
+            last_report = policy_ipc::now_ns();
+        }
+    }
+
+    report();
+
+    for (auto& entry : clients)
+        close(entry.first);
+    close(listener);
+    close(poller);
+    unlink(socket_path.c_str());
+    if (ring)
+    {
+        munmap(ring, policy_ipc::ring_size(slot_count));
+        shm_unlink(shm_name.c_str());
+    }
+    genann_free(ann);
+
+    return EXIT_SUCCESS;
+}
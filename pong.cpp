@@ -25,11 +25,16 @@ SOFTWARE.
 
 #include "pong.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 #include <cstring>
 
 #include <SFML/Graphics/RenderTarget.hpp>
 
+#include "random.hpp"
+#include "assets.hpp"
+
 bool PongPlayField::test_paddle_hit(const sf::Vector2f& ball, const sf::Vector2f& paddle)
 {
     return ball.x - ballRadius < paddle.x &&
@@ -51,6 +56,8 @@ float PongPlayField::new_angle(const sf::Vector2f& ball, const sf::Vector2f& pad
 PongPlayField::PongPlayField(sf::Vector2i size, sf::Color ball_color, sf::Color pad_color)
     : m_size(size)
 {
+    hidden_neurons = 2;
+
     m_paddle.setSize(paddleSize - sf::Vector2f(3*2, 3*2));
     m_paddle.setOutlineThickness(3*2);
     m_paddle.setOutlineColor(sf::Color::Black);
@@ -68,8 +75,7 @@ PongPlayField::PongPlayField(sf::Vector2i size, sf::Color ball_color, sf::Color
     m_border.setOutlineThickness(3);
     m_border.setOutlineColor(sf::Color::Black);
 
-    m_da_font.loadFromFile("resources/sansation.ttf");
-    m_score_text.setFont(m_da_font);
+    m_score_text.setFont(shared_font("resources/sansation.ttf"));
     m_score_text.setCharacterSize(80);
     m_score_text.move(20, 0);
 
@@ -78,21 +84,38 @@ PongPlayField::PongPlayField(sf::Vector2i size, sf::Color ball_color, sf::Color
 
 void PongPlayField::reset()
 {
-    nn_init(net, 3, 1, 2, 1);
+    nn_init(net, 3, hidden_layers, hidden_neurons, 1);
+
+    restart();
+}
 
+void PongPlayField::restart()
+{
     // Reset the position of the paddles and ball
     m_paddle.setPosition(10 + paddleSize.x / 2, m_size.y / 2);
     m_ball.setPosition(m_size.x / 2, m_size.y / 2);
 
-    // Reset the ball angle
-    do
+    m_seeded = start != nullptr;
+    if (start)
     {
-        // Make sure the ball initial angle is not too much vertical
-        ball_angle = (std::rand() % 360) * 2 * M_PI / 360;
+        m_ball.setPosition(start->x, start->y);
+        ball_angle = start->angle;
+        m_bounce_engine.seed(start->seed);
+    }
+    else
+    {
+        // Reset the ball angle
+        do
+        {
+            // Make sure the ball initial angle is not too much vertical
+            ball_angle = random_int(360) * 2 * M_PI / 360;
+        }
+        while (std::abs(std::cos(ball_angle)) < 0.7f);
     }
-    while (std::abs(std::cos(ball_angle)) < 0.7f);
 
     m_score = 1;
+    m_elapsed_time = 0;
+    m_update_count = 0;
     m_score_text.setFillColor(sf::Color::White);
 }
 
@@ -101,16 +124,44 @@ void PongPlayField::update(float deltaTime)
     if (!playing())
         return;
 
+    m_elapsed_time += deltaTime;
+
+    if (time_limit > 0 && m_elapsed_time > time_limit)
+    {
+        m_playing = false;
+        return;
+    }
+
     m_score += deltaTime * 10;
 
-    net.inputs[0] = ball_pos().x;
-    net.inputs[1] = ball_pos().y;
-    net.inputs[2] = paddle_pos().y;
+    if (control_tick())
+    {
+        net.inputs[0] = ball_pos().x;
+        net.inputs[1] = ball_pos().y;
+        net.inputs[2] = paddle_pos().y;
 
-    nn_run(net);
+        run_net();
 
-    dir = 1.0 - net.outputs[0]*2;
+        dir = 1.0 - net.outputs[0]*2;
+    }
 
+    if (event_driven)
+        advance(deltaTime);
+    else
+    {
+        const int substeps = std::max(physics_substeps, 1);
+        for (int i { 0 }; i < substeps && playing(); ++i)
+            step(deltaTime / substeps);
+    }
+
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "Score : %.3f", m_score);
+
+    m_score_text.setString(buffer);
+}
+
+void PongPlayField::step(float deltaTime)
+{
     // Move the player's paddle
     if (dir > 0 &&
             (m_paddle.getPosition().y - paddleSize.y / 2 > 5.f))
@@ -157,9 +208,9 @@ void PongPlayField::update(float deltaTime)
     if (test_paddle_hit(m_ball.getPosition(), m_paddle.getPosition()))
     {
         if (m_ball.getPosition().y > m_paddle.getPosition().y)
-            ball_angle = M_PI - ball_angle + (std::rand() % 20) * M_PI / 180;
+            ball_angle = M_PI - ball_angle + bounce_int(20) * M_PI / 180;
         else
-            ball_angle = M_PI - ball_angle - (std::rand() % 20) * M_PI / 180;
+            ball_angle = M_PI - ball_angle - bounce_int(20) * M_PI / 180;
 
         ball_angle = new_angle(m_ball.getPosition(), m_paddle.getPosition());
 
@@ -171,23 +222,114 @@ void PongPlayField::update(float deltaTime)
     // wall bounce
     if (m_ball.getPosition().x + ballRadius > m_size.x)
     {
-        ball_angle = -(M_PI + std::fmod((double)std::rand(), max_bounce_angle*2) - max_bounce_angle);
+        ball_angle = -(M_PI + std::fmod((double)bounce_draw(), max_bounce_angle*2) - max_bounce_angle);
 
         m_ball.setPosition(m_size.x - ballRadius - paddleSize.x / 2 - 0.1f, m_ball.getPosition().y);
     }
+}
 
-    char buffer[1024];
-    snprintf(buffer, sizeof(buffer), "Score : %.3f", m_score);
-
-    m_score_text.setString(buffer);
+void PongPlayField::advance(float deltaTime)
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    const float paddle_reach = paddleSize.y / 2 + ballRadius; // vertical distance still hitting
+    const float paddle_low   = 5.f + paddleSize.y / 2;
+    const float paddle_high  = m_size.y - 5.f - paddleSize.y / 2;
+
+    float remaining = deltaTime;
+    // a rally only bounces so often per update, this only guards against float ties
+    for (int events { 0 }; events < 64 && remaining > 0 && playing(); ++events)
+    {
+        sf::Vector2f ball   = m_ball.getPosition();
+        sf::Vector2f paddle = m_paddle.getPosition();
+        float vx = std::cos(ball_angle) * ballSpeed;
+        float vy = std::sin(ball_angle) * ballSpeed;
+
+        float pv = 0;
+        float paddle_stop = infinity;
+        if (dir > 0 && paddle.y > paddle_low + 1e-3f)
+        {
+            pv = -paddleSpeed;
+            paddle_stop = (paddle.y - paddle_low) / paddleSpeed;
+        }
+        else if (dir < 0 && paddle.y < paddle_high - 1e-3f)
+        {
+            pv = paddleSpeed;
+            paddle_stop = (paddle_high - paddle.y) / paddleSpeed;
+        }
+
+        // time until x + speed * t reaches limit, speed heading towards it ; 0 if already past
+        auto crossing = [](float x, float speed, float limit)
+        { return std::max(0.f, (limit - x) / speed); };
+
+        float wall_low  = vy < 0 ? crossing(ball.y - ballRadius, vy, 0.f) : infinity;
+        float wall_high = vy > 0 ? crossing(ball.y + ballRadius, vy, m_size.y) : infinity;
+        float wall_far  = vx > 0 ? crossing(ball.x + ballRadius, vx, m_size.x) : infinity;
+        float lost      = vx < 0 ? crossing(ball.x - ballRadius, vx, 0.f) : infinity;
+
+        // hit : behind the paddle's center line while within its reach
+        float behind = ball.x - ballRadius < paddle.x ? 0.f : vx < 0 ? crossing(ball.x - ballRadius, vx, paddle.x) : infinity;
+        float gap = ball.y - paddle.y, closing = vy - pv;
+        float reach_begin = 0, reach_end = infinity;
+        if (closing != 0)
+        {
+            float t0 = (-paddle_reach - gap) / closing, t1 = (paddle_reach - gap) / closing;
+            reach_begin = std::max(0.f, std::min(t0, t1));
+            reach_end   = std::max(t0, t1);
+        }
+        else if (std::abs(gap) > paddle_reach)
+            reach_begin = infinity;
+        float hit = std::max(behind, reach_begin);
+        if (hit > reach_end)
+            hit = infinity;
+
+        float next = std::min({ wall_low, wall_high, wall_far, lost, hit, paddle_stop, remaining });
+
+        m_ball.move(vx * next, vy * next);
+        m_paddle.move(0.f, pv * next);
+        remaining -= next;
+
+        ball = m_ball.getPosition();
+        if (next == lost)
+        {
+            m_playing = false;
+
+            float distance = std::abs(ball.y - m_paddle.getPosition().y);
+            m_score -= distance / 4.0f;
+
+            m_score_text.setFillColor(sf::Color::Red);
+        }
+        else if (next == hit)
+        {
+            // step() draws a deflection before new_angle() overrides it : so
+            // does this, both modes consuming the same random sequence
+            bounce_int(20);
+            ball_angle = new_angle(ball, m_paddle.getPosition());
+            m_ball.setPosition(m_paddle.getPosition().x + ballRadius + paddleSize.x / 2 + 0.1f, ball.y);
+        }
+        else if (next == wall_low)
+        {
+            ball_angle = -ball_angle;
+            m_ball.setPosition(ball.x, ballRadius + 0.1f);
+        }
+        else if (next == wall_high)
+        {
+            ball_angle = -ball_angle;
+            m_ball.setPosition(ball.x, m_size.y - ballRadius - 0.1f);
+        }
+        else if (next == wall_far)
+        {
+            ball_angle = -(M_PI + std::fmod((double)bounce_draw(), max_bounce_angle*2) - max_bounce_angle);
+            m_ball.setPosition(m_size.x - ballRadius - paddleSize.x / 2 - 0.1f, ball.y);
+        }
+        else if (next == paddle_stop)
+            m_paddle.setPosition(paddle.x, pv < 0 ? paddle_low : paddle_high);
+    }
 }
 
 void PongPlayField::draw(sf::RenderTarget &target, sf::RenderStates states) const
 {
     states.transform *= getTransform();
 
-
-    m_score_text.setFont(m_da_font);
     if (playing())
     {
         target.draw(m_ball, states);
@@ -197,7 +339,23 @@ void PongPlayField::draw(sf::RenderTarget &target, sf::RenderStates states) cons
     target.draw(m_border, states);
 }
 
+unsigned PongPlayField::bounce_draw()
+{
+    return m_seeded ? m_bounce_engine() : random_engine()();
+}
+
+int PongPlayField::bounce_int(int max)
+{
+    return m_seeded ? (int)(m_bounce_engine() % max) : random_int(max);
+}
+
 float PongPlayField::score() const
 {
     return m_score;
 }
+
+void PongPlayField::finish(float score)
+{
+    m_score = score;
+    set_playing(false);
+}
@@ -27,6 +27,8 @@ SOFTWARE.
 
 #include "playfield.hpp"
 
+#include <random>
+
 #include <SFML/Graphics/RectangleShape.hpp>
 #include <SFML/Graphics/CircleShape.hpp>
 
@@ -48,9 +50,14 @@ public:
     PongPlayField(sf::Vector2i size = {800, 600}, sf::Color ball_color = sf::Color::White, sf::Color pad_color = sf::Color(100, 100, 200));
 
     void  reset() override;
+    void  restart() override;
     void  update(float dt) override;
     void  draw(sf::RenderTarget& target, sf::RenderStates states) const override;
     float score() const override;
+    // the bounces being random, only episodes started from a scenario are
+    bool  deterministic() const override
+    { return start != nullptr; }
+    void  finish(float score) override;
 
     sf::Vector2f ball_pos() const
     { return m_ball.getPosition(); }
@@ -58,20 +65,34 @@ public:
     { return m_paddle.getPosition(); }
 
 private:
+    // physics only, the paddle following dir
+    void step(float deltaTime);
+    // the same rules in continuous time
+    void advance(float deltaTime);
     bool test_paddle_hit(const sf::Vector2f& ball, const sf::Vector2f& paddle);
     float new_angle(const sf::Vector2f& ball, const sf::Vector2f& paddle_center);
+    // bounce randomness, from the scenario's seed if the episode has one
+    unsigned bounce_draw();
+    int      bounce_int(int max);
 
 public:
     double dir { 0 };
     float ball_angle { 0 };
 
+    // Moves the ball and paddle analytically from one collision to the next
+    // instead of in fixed steps : an update costs one net query and a few
+    // events whatever its length, so long time steps lose no accuracy.
+    bool event_driven { false };
+
 private:
     float m_score { 1 };
+    float m_elapsed_time { 0 };
+    bool  m_seeded { false };
+    std::mt19937 m_bounce_engine;
     sf::Vector2i m_size;
     sf::RectangleShape m_paddle;
     sf::CircleShape m_ball;
     sf::RectangleShape m_border;
-    sf::Font m_da_font;
     mutable sf::Text m_score_text;
 };
 
@@ -0,0 +1,195 @@
+/*
+pong_duel.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "pong_duel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// PongPlayField's
+const float paddle_width  = 25.f*2;
+const float paddle_height = 100.f*2;
+const float ball_radius   = 10.f*2;
+const float max_bounce_angle = 3.1415926/4;
+const float paddle_speed  = 500.f*2;
+const float ball_speed    = 600.f*2;
+
+// splitmix64
+uint64_t next_random(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+}
+
+const size_t pong_duels::batch_size;
+
+pong_duels::pong_duels(const rules &r)
+    : m_rules(r),
+      m_left_x(10 + paddle_width / 2), m_right_x(r.width - 10 - paddle_width / 2),
+      m_ball_x(batch_size), m_ball_y(batch_size), m_angle(batch_size), m_random(batch_size)
+{
+    for (int side { 0 }; side < 2; ++side)
+    {
+        m_paddle_y[side].resize(batch_size);
+        m_dir[side].resize(batch_size);
+        m_score[side].resize(batch_size);
+    }
+}
+
+unsigned long long pong_duels::play(match *matches, size_t count, genann* const* nets)
+{
+    const int repeat   = std::max(m_rules.action_repeat, 1);
+    const int substeps = std::max(m_rules.physics_substeps, 1);
+    const long steps   = std::max(1L, (long)(m_rules.time_limit / m_rules.time_step));
+    const float dt     = m_rules.time_step / substeps;
+
+    unsigned long long ticks = 0;
+    for (size_t first { 0 }; first < count; first += batch_size)
+    {
+        match* batch = matches + first;
+        const size_t size = std::min(batch_size, count - first);
+
+        for (size_t i { 0 }; i < size; ++i)
+        {
+            m_random[i] = batch[i].seed;
+            for (int side { 0 }; side < 2; ++side)
+            {
+                m_paddle_y[side][i] = m_rules.height / 2;
+                m_dir[side][i]      = 0;
+                m_score[side][i]    = 0;
+            }
+            serve(i, next_random(m_random[i]) & 1);
+        }
+
+        // no match ends before the others
+        for (long tick { 0 }; tick < steps; ++tick)
+        {
+            if (tick % repeat == 0)
+            {
+                for (size_t i { 0 }; i < size; ++i)
+                {
+                    for (int side { 0 }; side < 2; ++side)
+                    {
+                        double inputs[3] = { side ? m_rules.width - m_ball_x[i] : m_ball_x[i], m_ball_y[i], m_paddle_y[side][i] };
+                        const double* outputs = genann_run(nets[side ? batch[i].right : batch[i].left], inputs);
+                        m_dir[side][i] = 1.0 - outputs[0]*2;
+                    }
+                }
+            }
+
+            for (int s { 0 }; s < substeps; ++s)
+            {
+                for (size_t i { 0 }; i < size; ++i)
+                    step(i, dt);
+            }
+        }
+        ticks += size * steps;
+
+        for (size_t i { 0 }; i < size; ++i)
+        {
+            batch[i].score[0] = m_score[0][i];
+            batch[i].score[1] = m_score[1][i];
+        }
+    }
+
+    return ticks;
+}
+
+void pong_duels::serve(size_t i, int towards)
+{
+    m_ball_x[i] = m_rules.width / 2;
+    m_ball_y[i] = m_rules.height / 2;
+
+    // as far from the horizontal as the single player's first ball
+    float offset = ((next_random(m_random[i]) >> 40) / float(1 << 24) * 2 - 1) * max_bounce_angle;
+    m_angle[i] = towards ? offset : (float)M_PI - offset;
+}
+
+void pong_duels::miss(size_t i, int side)
+{
+    float distance = std::abs(m_ball_y[i] - m_paddle_y[side][i]);
+    m_score[side][i]     -= 3 + distance / paddle_height;
+    m_score[1 - side][i] += 3;
+    serve(i, side);
+}
+
+void pong_duels::step(size_t i, float dt)
+{
+    for (int side { 0 }; side < 2; ++side)
+    {
+        float& paddle = m_paddle_y[side][i];
+        if (m_dir[side][i] > 0 && paddle - paddle_height / 2 > 5.f)
+            paddle -= paddle_speed * dt;
+        if (m_dir[side][i] < 0 && paddle + paddle_height / 2 < m_rules.height - 5.f)
+            paddle += paddle_speed * dt;
+    }
+
+    float& x = m_ball_x[i];
+    float& y = m_ball_y[i];
+    float& angle = m_angle[i];
+    x += std::cos(angle) * ball_speed * dt;
+    y += std::sin(angle) * ball_speed * dt;
+
+    if (y - ball_radius < 0.f)
+    {
+        angle = -angle;
+        y = ball_radius + 0.1f;
+    }
+    if (y + ball_radius > m_rules.height)
+    {
+        angle = -angle;
+        y = m_rules.height - ball_radius - 0.1f;
+    }
+
+    // returns, checked before the goals as the ball can't be hit anymore once in them
+    auto within = [&](int side)
+    {
+        float paddle = m_paddle_y[side][i];
+        return y + ball_radius >= paddle - paddle_height / 2 && y - ball_radius <= paddle + paddle_height / 2;
+    };
+    if (x - ball_radius < m_left_x && x - ball_radius >= 0.f && within(0))
+    {
+        angle = (y - m_paddle_y[0][i]) / (paddle_height / 2) * max_bounce_angle;
+        x = m_left_x + ball_radius + paddle_width / 2 + 0.1f;
+        m_score[0][i] += 1;
+    }
+    else if (x + ball_radius > m_right_x && x + ball_radius <= m_rules.width && within(1))
+    {
+        angle = (float)M_PI - (y - m_paddle_y[1][i]) / (paddle_height / 2) * max_bounce_angle;
+        x = m_right_x - ball_radius - paddle_width / 2 - 0.1f;
+        m_score[1][i] += 1;
+    }
+    else if (x - ball_radius < 0.f)
+        miss(i, 0);
+    else if (x + ball_radius > m_rules.width)
+        miss(i, 1);
+}
@@ -0,0 +1,91 @@
+/*
+pong_duel.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef PONG_DUEL_HPP
+#define PONG_DUEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "genann.h"
+
+// Two-paddle pong between two nets, with PongPlayField's dimensions and
+// rules, each paddle seeing the court as the single player does (ball x and
+// y, its own paddle's y, x measured from its own goal). A missed ball is a
+// point for the other side and is served again from the centre towards the
+// side that lost it, until the time limit.
+//
+// A match is scored for both sides : 1 per return, 3 per point won, -3 per
+// point lost minus the distance the paddle was from the missed ball in
+// paddle heights, so that nets first learn to follow the ball. It only
+// depends on its two nets and its seed, which draws the serves.
+//
+// Matches are stepped in lockstep, a batch at a time, their state held in
+// one array per variable.
+class pong_duels
+{
+public:
+    struct rules
+    {
+        float width  { 1600 };
+        float height { 800 };
+        float time_limit { 10 }; // seconds per match, must be positive
+        float time_step  { 1/60.f };
+        int   action_repeat    { 1 };
+        int   physics_substeps { 1 };
+    };
+
+    struct match
+    {
+        size_t   left, right; // indices of the nets
+        uint64_t seed;
+        float    score[2];    // results, left then right
+    };
+
+    explicit pong_duels(const rules& r);
+
+    // Plays the matches to their end, nets[match.left] against nets[match.right].
+    // The nets' scratch buffers are written : a thread needs its own copies.
+    // Returns the time steps played.
+    unsigned long long play(match* matches, size_t count, genann* const* nets);
+
+private:
+    static const size_t batch_size = 64;
+
+    void serve(size_t i, int towards);
+    void miss(size_t i, int side);
+    void step(size_t i, float dt);
+
+    rules m_rules;
+    float m_left_x, m_right_x; // paddle centres
+    // per match of the batch
+    std::vector<float> m_ball_x, m_ball_y, m_angle;
+    std::vector<float> m_paddle_y[2];
+    std::vector<double> m_dir[2];
+    std::vector<float> m_score[2];
+    std::vector<uint64_t> m_random;
+};
+
+#endif // PONG_DUEL_HPP
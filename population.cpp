@@ -0,0 +1,629 @@
+/*
+population.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "population.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+#include "common.hpp"
+#include "playfield.hpp"
+#include "lander.hpp"
+#include "pong.hpp"
+#include "imitation.hpp"
+
+#include "genann.h"
+
+population::population(const experiment_config &config)
+    : m_config(config)
+{
+    m_stats.name = config.name;
+    m_stats.best_score = -std::numeric_limits<float>::infinity();
+
+    if (!config.coevolution.empty() && (config.environment != "pong" || config.time_limit <= 0))
+    {
+        fprintf(stderr, "%s: co-evolution needs the pong environment and a time limit\n", config.name.c_str());
+        return;
+    }
+
+    if (!config.scenario_bank.empty())
+    {
+        if (!m_bank.open(config.scenario_bank))
+            return;
+        if (m_bank.environment() != config.environment || !m_bank.size())
+        {
+            fprintf(stderr, "%s: '%s' holds no %s scenarios\n", config.name.c_str(), config.scenario_bank.c_str(), config.environment.c_str());
+            return;
+        }
+        // the bank's ground replaces a generated one
+        auto points = m_bank.terrain_points();
+        if (!points.empty())
+        {
+            auto ground = std::make_shared<terrain>();
+            ground->set_points(points);
+            m_ground = ground;
+        }
+    }
+
+    for (size_t i { 0 }; i < std::max<size_t>(config.population, 2); ++i)
+    {
+        auto* field = make_field(config.environment, sf::Vector2i{gameWidth, gameHeight});
+        if (!field)
+        {
+            fprintf(stderr, "%s: unknown environment '%s'\n", config.name.c_str(), config.environment.c_str());
+            return;
+        }
+        field->hidden_layers  = config.hidden_layers;
+        field->hidden_neurons = config.hidden_neurons;
+        field->time_limit     = config.time_limit;
+        field->action_repeat    = config.action_repeat;
+        field->physics_substeps = config.physics_substeps;
+        field->sparse_inference  = config.sparse_inference;
+        field->blocked_inference = config.blocked_inference;
+        if (auto* pong = dynamic_cast<PongPlayField*>(field))
+            pong->event_driven = config.event_driven;
+        if (auto* lander = dynamic_cast<LanderPlayField*>(field))
+        {
+            if (config.terrain && !m_ground)
+                m_ground = std::make_shared<terrain>(lander->generate_ground(config.terrain_seed, config.terrain_roughness));
+            lander->ground    = m_ground;
+            lander->ray_count = config.lander_rays;
+            lander->ray_fan   = config.lander_ray_fan;
+            lander->ray_range = config.lander_ray_range;
+        }
+        field->reset();
+        m_fields.emplace_back(field);
+    }
+
+    m_scenarios.assign(m_fields.size(), 0);
+    assign_scenarios(0);
+
+    if (!config.imitation_log.empty())
+        imitate(config);
+
+    // every lander records into its own buffer, only the best flights get written
+    if (!config.record_dir.empty() && config.environment == "lander" &&
+            m_recorder.open(output_path(config, config.record_dir, ".traj")))
+    {
+        m_recordings.resize(m_fields.size());
+        size_t max_ticks = config.time_limit > 0 ? config.time_limit / config.time_step + 2 : 1024;
+        for (size_t i { 0 }; i < m_fields.size(); ++i)
+        {
+            m_recordings[i].samples().reserve(max_ticks * trajectory_buffer::channels);
+            static_cast<LanderPlayField*>(m_fields[i])->recording = &m_recordings[i];
+        }
+    }
+
+    if (config.prune && !config.prune_log_dir.empty())
+    {
+        auto path = output_path(config, config.prune_log_dir, ".prune.csv");
+        if ((m_prune_log = fopen(path.c_str(), "w")))
+            fprintf(m_prune_log, "generation,field,score,upper_bound,threshold\n");
+        else
+            perror(path.c_str());
+    }
+
+    if (!config.diversity_log_dir.empty())
+    {
+        auto path = output_path(config, config.diversity_log_dir, ".diversity.csv");
+        if ((m_diversity_log = fopen(path.c_str(), "w")))
+            fprintf(m_diversity_log, "generation,mean_distance,median_distance,mean_gene_variance,max_gene_variance,fixed_genes,clusters,pairs,mutated_genes\n");
+        else
+            perror(path.c_str());
+    }
+    m_mutated_genes = config.mutated_genes;
+
+    // a cached episode is not flown : it would leave a hole in the flight log
+    // and report the objectives and behaviour of the initial state
+    if (config.fitness_cache && config.coevolution.empty() && m_recordings.empty() && !config.multi_objective && !config.novelty && m_fields[0]->deterministic())
+        m_cache.reset(new fitness_cache(4 * m_fields.size()));
+
+    ga_params params;
+    params.mutation_factor   = config.mutation_factor;
+    params.mutated_genes     = config.mutated_genes;
+    params.random_immigrants = config.random_immigrants;
+    params.multi_objective   = config.multi_objective;
+    params.connection_removal  = config.connection_removal;
+    params.connection_addition = config.connection_addition;
+    params.mutation.gaussian   = config.mutation == "gaussian";
+    params.mutation.rate       = config.mutation_rate;
+    params.mutation.sigma      = config.mutation_sigma;
+    params.mutation.step_rule  = config.mutation_step_rule;
+    m_pipeline.reset(new generation_pipeline(params));
+
+    if (config.novelty && !config.multi_objective && m_fields[0]->behaviour_size())
+        m_archive.reset(new novelty_archive(m_fields[0]->behaviour_size()));
+
+    if (!config.coevolution.empty())
+    {
+        matchmaking_params matches;
+        matches.format       = config.coevolution;
+        matches.opponents    = config.coevolution_opponents;
+        matches.hall_of_fame = config.hall_of_fame_size;
+        matches.threads      = config.coevolution_threads;
+        matches.seed         = config.seed;
+        matches.rules.width  = gameWidth;
+        matches.rules.height = gameHeight;
+        matches.rules.time_limit = config.time_limit;
+        matches.rules.time_step  = config.time_step;
+        matches.rules.action_repeat    = config.action_repeat;
+        matches.rules.physics_substeps = config.physics_substeps;
+        m_matchmaker.reset(new matchmaker(matches));
+    }
+
+    es_params es;
+    es.sigma         = config.es_sigma;
+    es.learning_rate = config.es_learning_rate;
+    m_strategy.reset(make_strategy(config.optimizer, es));
+}
+
+void population::imitate(const experiment_config &config)
+{
+    training_set demonstrations;
+    // the flight logs hold no ray distances
+    if (config.environment != "lander" || config.lander_rays > 0 || !load_demonstrations(config.imitation_log, config.imitation_min_score, demonstrations))
+    {
+        fprintf(stderr, "%s: can't imitate '%s'\n", config.name.c_str(), config.imitation_log.c_str());
+        return;
+    }
+
+    backprop_params params;
+    params.learning_rate = config.imitation_learning_rate;
+    params.epochs        = config.imitation_epochs;
+    params.threads       = config.imitation_threads;
+    params.fresh_start   = true;
+
+    // the first generation is bred from the first fields, all scores being equal
+    genann* student = m_fields[0]->net.nn;
+    double error = train_network(student, demonstrations, params);
+    for (size_t i { 1 }; i < parent_count; ++i)
+        std::memcpy(m_fields[i]->net.nn->weight, student->weight, sizeof(double) * student->total_weights);
+
+    fprintf(stderr, "%s: imitated %zu ticks, mean squared error %.5f\n", config.name.c_str(), demonstrations.size(), error);
+}
+
+population::~population()
+{
+    m_pipeline.reset(); // frees the nets bred in advance, if any
+
+    for (auto* field : m_fields)
+    {
+        nn_free(field->net);
+        delete field;
+    }
+
+    if (m_prune_log)
+        fclose(m_prune_log);
+    if (m_diversity_log)
+        fclose(m_diversity_log);
+}
+
+void population::advance()
+{
+    assign_scenarios(m_generation + 1);
+    if (m_strategy)
+    {
+        if (m_generation >= 0)
+            m_strategy->update(m_fields);
+        m_strategy->sample(m_fields);
+    }
+    else
+        m_pipeline->advance(m_fields, m_novelty.empty() ? nullptr : &m_novelty);
+    ++m_generation;
+}
+
+void population::evaluate()
+{
+    // the nets are final once the generation started and migrants arrived
+    if (m_config.sparse_inference || m_config.blocked_inference)
+    {
+        for (auto* field : m_fields)
+            field->compile_net();
+    }
+
+    if (m_matchmaker)
+        play_matches();
+    else
+        fly();
+
+    float best = -std::numeric_limits<float>::infinity();
+    double total = 0;
+    for (const auto* field : m_fields)
+    {
+        best   = std::max(best, field->score());
+        total += field->score();
+    }
+
+    if (m_archive)
+        score_novelty();
+
+    m_stats.generations = m_generation + 1;
+    m_stats.evaluations += m_fields.size();
+    m_stats.final_best  = best;
+    m_stats.final_mean  = total / m_fields.size();
+    m_stats.best_score  = std::max(m_stats.best_score, best);
+    m_stats.early_bred  = m_pipeline->early_count();
+
+    if (m_diversity_log || m_config.diversity_target > 0)
+        track_diversity();
+    if (!m_strategy && !m_config.multi_objective && m_config.mutation == "gaussian" && m_config.mutation_step_rule == "one_fifth")
+        adapt_mutation_sigma();
+    if (!m_config.lineage_dir.empty())
+        record_lineage();
+
+    if (!m_recordings.empty())
+    {
+        std::vector<size_t> ranking(m_fields.size());
+        for (size_t i { 0 }; i < ranking.size(); ++i)
+            ranking[i] = i;
+        size_t recorded = std::min(m_config.record_top, ranking.size());
+        std::partial_sort(ranking.begin(), ranking.begin() + recorded, ranking.end(), [&](size_t lhs, size_t rhs)
+        { return m_fields[lhs]->score() > m_fields[rhs]->score(); });
+
+        for (size_t i { 0 }; i < recorded; ++i)
+            m_recorder.commit(m_generation, ranking[i], m_fields[ranking[i]]->score(), m_config.time_step, m_recordings[ranking[i]]);
+        for (auto& recording : m_recordings)
+            recording.clear();
+    }
+}
+
+void population::fly()
+{
+    if (m_cache)
+    {
+        m_cacheable.assign(m_fields.size(), 0);
+        m_flying.resize(m_fields.size());
+        for (size_t i { 0 }; i < m_fields.size(); ++i)
+        {
+            float score;
+            if (m_cache->lookup(m_fields[i]->net.nn, m_scenarios[i], score))
+                m_fields[i]->finish(score);
+            else
+                m_cacheable[i] = m_fields[i]->playing();
+        }
+    }
+
+    bool any_playing = true;
+    while (any_playing)
+    {
+        if (m_ground && m_config.lander_rays > 0)
+            cast_rays();
+
+        any_playing = false;
+        for (auto* field : m_fields)
+        {
+            if (!field->playing())
+                continue;
+
+            field->update(m_config.time_step);
+            any_playing |= field->playing();
+            ++m_stats.ticks;
+        }
+
+        // the strategies rank every sample, none can be cut short
+        if (m_config.prune && !m_strategy && !m_config.multi_objective && !m_archive && any_playing)
+        {
+            // a pruned score is not the one the genome would have finished with
+            for (size_t i { 0 }; i < m_cacheable.size(); ++i)
+                m_flying[i] = m_fields[i]->playing();
+            m_stats.pruned += prune_hopeless(m_fields, m_generation, m_prune_log);
+            for (size_t i { 0 }; i < m_cacheable.size(); ++i)
+                m_cacheable[i] &= !m_flying[i] || m_fields[i]->playing();
+        }
+        if (any_playing && !m_strategy && !m_archive)
+            m_pipeline->update(m_fields);
+    }
+
+    if (m_cache)
+    {
+        for (size_t i { 0 }; i < m_fields.size(); ++i)
+        {
+            if (m_cacheable[i])
+                m_cache->store(m_fields[i]->net.nn, m_scenarios[i], m_fields[i]->score());
+        }
+        m_cache->end_generation();
+        m_stats.cache_hits   = m_cache->hits();
+        m_stats.cache_misses = m_cache->misses();
+    }
+}
+
+void population::play_matches()
+{
+    m_genomes.clear();
+    for (const auto* field : m_fields)
+        m_genomes.push_back(field->net.nn);
+
+    const unsigned long long ticks = m_matchmaker->ticks();
+    m_matchmaker->play(m_genomes, m_generation, m_match_scores);
+    for (size_t i { 0 }; i < m_fields.size(); ++i)
+        m_fields[i]->finish(m_match_scores[i]);
+
+    m_stats.ticks       += m_matchmaker->ticks() - ticks;
+    m_stats.cache_hits   = m_matchmaker->hits();
+    m_stats.cache_misses = m_matchmaker->misses();
+}
+
+void population::track_diversity()
+{
+    m_genomes.clear();
+    for (const auto* field : m_fields)
+        m_genomes.push_back(field->net.nn);
+
+    diversity_params params;
+    params.max_pairs      = m_config.diversity_max_pairs;
+    params.cluster_radius = m_config.diversity_cluster_radius;
+    auto stats = measure_diversity(m_genomes, params, (uint64_t)m_config.seed << 32 | (uint32_t)m_generation);
+
+    // the genetic algorithm breeds from its two best : mutating more genes
+    // is what keeps its children apart once they collapse onto them
+    if (m_config.diversity_target > 0 && !m_strategy)
+    {
+        if (stats.median_distance < m_config.diversity_target)
+            m_mutated_genes = std::min(m_mutated_genes * 1.5, (double)m_genomes[0]->total_weights);
+        else
+            m_mutated_genes = std::max((double)m_config.mutated_genes, m_mutated_genes / 1.5);
+        m_pipeline->set_mutated_genes((int)std::lround(m_mutated_genes));
+    }
+
+    if (m_diversity_log)
+        fprintf(m_diversity_log, "%d,%.6f,%.6f,%.6g,%.6g,%zu,%zu,%zu,%ld\n", m_generation, stats.mean_distance, stats.median_distance, stats.mean_gene_variance,
+                stats.max_gene_variance, stats.fixed_genes, stats.clusters, stats.pairs, std::lround(m_mutated_genes));
+}
+
+void population::adapt_mutation_sigma()
+{
+    m_scores.clear();
+    for (const auto* field : m_fields)
+        m_scores.push_back(field->score());
+
+    // the children are the fields before the random immigrants, a success
+    // beats the worst parent they were bred from
+    const size_t children = m_scores.size() - std::min(m_config.random_immigrants, m_scores.size());
+    if (m_generation > 0 && children > 0)
+    {
+        size_t successes = std::count_if(m_scores.begin(), m_scores.begin() + children, [this](float score)
+        { return score > m_parent_threshold; });
+        m_pipeline->set_mutation_sigma(one_fifth_sigma(m_pipeline->mutation_sigma(), (double)successes / children));
+    }
+
+    const size_t rank = std::min(parent_count, m_scores.size()) - 1;
+    std::nth_element(m_scores.begin(), m_scores.begin() + rank, m_scores.end(), std::greater<float>{});
+    m_parent_threshold = m_scores[rank];
+}
+
+void population::record_lineage()
+{
+    if (!m_lineage.is_open() && !m_lineage.open(output_path(m_config, m_config.lineage_dir, ".lineage"),
+                                                m_config.lineage_keyframe_interval, m_resumed))
+    {
+        m_config.lineage_dir.clear();
+        return;
+    }
+
+    m_genomes.clear();
+    m_lineage_scores.clear();
+    for (const auto* field : m_fields)
+    {
+        m_genomes.push_back(field->net.nn);
+        m_lineage_scores.push_back(field->score());
+    }
+    if (!m_lineage.append(m_generation, m_genomes, m_lineage_scores))
+        fprintf(stderr, "%s: can't write the lineage of generation %d\n", m_config.name.c_str(), m_generation);
+}
+
+void population::assign_scenarios(int generation)
+{
+    if (!m_bank.size())
+        return;
+
+    const size_t per_generation = m_config.scenarios_per_generation;
+    for (size_t i { 0 }; i < m_fields.size(); ++i)
+    {
+        m_scenarios[i] = ((uint64_t)generation * per_generation + i % per_generation) % m_bank.size();
+        m_fields[i]->start = &m_bank[m_scenarios[i]];
+    }
+}
+
+void population::cast_rays()
+{
+    m_rays.clear();
+    m_ray_fields.clear();
+    for (size_t i { 0 }; i < m_fields.size(); ++i)
+    {
+        if (static_cast<LanderPlayField*>(m_fields[i])->pending_rays(m_rays))
+            m_ray_fields.push_back(i);
+    }
+
+    m_ray_distances.resize(m_rays.size());
+    m_ground->raycast(m_rays.data(), m_rays.size(), m_ray_distances.data());
+
+    for (size_t j { 0 }; j < m_ray_fields.size(); ++j)
+        static_cast<LanderPlayField*>(m_fields[m_ray_fields[j]])->set_ray_distances(m_ray_distances.data() + j * m_config.lander_rays);
+}
+
+void population::score_novelty()
+{
+    const int dimension = m_fields[0]->behaviour_size();
+    std::vector<float> behaviours(m_fields.size() * dimension);
+    for (size_t i { 0 }; i < m_fields.size(); ++i)
+        m_fields[i]->behaviour(&behaviours[i * dimension]);
+
+    m_novelty = novelty_scores(*m_archive, behaviours, dimension, m_config.novelty_k, m_config.novelty_threads);
+
+    std::vector<size_t> ranking(m_fields.size());
+    for (size_t i { 0 }; i < ranking.size(); ++i)
+        ranking[i] = i;
+    size_t archived = std::min(m_config.novelty_archive_add, ranking.size());
+    std::partial_sort(ranking.begin(), ranking.begin() + archived, ranking.end(), [&](size_t lhs, size_t rhs)
+    { return m_novelty[lhs] > m_novelty[rhs]; });
+    for (size_t i { 0 }; i < archived; ++i)
+        m_archive->add(&behaviours[ranking[i] * dimension]);
+}
+
+const PlayField *population::champion() const
+{
+    return *std::max_element(m_fields.begin(), m_fields.end(), [](const PlayField* lhs, const PlayField* rhs)
+    { return lhs->score() < rhs->score(); });
+}
+
+bool population::save_champion(const std::string &path) const
+{
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out)
+    {
+        perror(path.c_str());
+        return false;
+    }
+
+    genann_write(champion()->net.nn, out);
+    fclose(out);
+    return true;
+}
+
+bool population::save_front(const std::string &path) const
+{
+    FILE* out = fopen(path.c_str(), "w");
+    if (!out)
+    {
+        perror(path.c_str());
+        return false;
+    }
+
+    std::vector<int> front;
+    auto order = pareto_ranking(m_fields, front);
+    std::vector<float> objectives(m_fields[0]->objective_count());
+    for (size_t index : order)
+    {
+        if (front[index] != 0)
+            break;
+
+        m_fields[index]->objectives(objectives.data());
+        for (float objective : objectives)
+            fprintf(out, "%.9g ", objective);
+        genann_write(m_fields[index]->net.nn, out);
+        fprintf(out, "\n");
+    }
+
+    fclose(out);
+    return true;
+}
+
+const char* population::unsaved_state() const
+{
+    if (m_strategy)
+        return "evolution strategy's mean, covariance and step size";
+    if (m_config.mutation == "gaussian" && m_config.mutation_step_rule != "fixed")
+        return "adapted mutation steps";
+    if (m_config.diversity_target > 0)
+        return "mutated gene count adapted to the diversity";
+    if (m_matchmaker)
+        return "hall of fame";
+    if (m_archive)
+        return "novelty archive";
+    return nullptr;
+}
+
+bool population::save(const std::string &path) const
+{
+    if (unsaved_state())
+        return false;
+
+    std::string temporary = path + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "w");
+    if (!out)
+    {
+        perror(temporary.c_str());
+        return false;
+    }
+
+    fprintf(out, "%d %zu %.9g %llu %llu %llu\n", m_generation, m_fields.size(), m_stats.best_score,
+            m_stats.evaluations, m_stats.ticks, m_stats.pruned);
+    for (const auto* field : m_fields)
+    {
+        genann_write(field->net.nn, out);
+        fprintf(out, "\n");
+    }
+
+    bool written = !ferror(out);
+    written &= fclose(out) == 0;
+    return written && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool population::load(const std::string &path)
+{
+    if (const char* missing = unsaved_state())
+    {
+        fprintf(stderr, "%s: checkpoints don't keep the %s, starting over instead of resuming\n", m_config.name.c_str(), missing);
+        return false;
+    }
+
+    FILE* in = fopen(path.c_str(), "r");
+    if (!in)
+        return false;
+
+    int generation;
+    size_t count;
+    experiment_result stats = m_stats;
+    if (fscanf(in, "%d %zu %f %llu %llu %llu", &generation, &count, &stats.best_score,
+               &stats.evaluations, &stats.ticks, &stats.pruned) != 6 || count != m_fields.size())
+    {
+        fclose(in);
+        return false;
+    }
+
+    std::vector<neural_net> nets;
+    for (size_t i { 0 }; i < count; ++i)
+    {
+        genann* saved = genann_read(in);
+        if (!saved || saved->total_weights != m_fields[i]->net.nn->total_weights)
+        {
+            if (saved)
+                genann_free(saved);
+            break;
+        }
+
+        nets.emplace_back(nn_clone(m_fields[i]->net));
+        std::memcpy(nets.back().nn->weight, saved->weight, sizeof(double) * saved->total_weights);
+        genann_free(saved);
+    }
+    fclose(in);
+
+    if (nets.size() != count)
+    {
+        for (auto& net : nets)
+            nn_free(net);
+        return false;
+    }
+
+    assign_scenarios(generation);
+    start_generation(m_fields, nets);
+    m_generation = generation;
+    m_resumed = true;
+    m_stats = stats;
+    return true;
+}
@@ -0,0 +1,158 @@
+/*
+population.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef POPULATION_HPP
+#define POPULATION_HPP
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "diversity.hpp"
+#include "experiment.hpp"
+#include "fitness_cache.hpp"
+#include "lineage.hpp"
+#include "matchmaking.hpp"
+#include "evolution_strategy.hpp"
+#include "novelty.hpp"
+#include "scenario_bank.hpp"
+#include "terrain.hpp"
+#include "trainer.hpp"
+#include "trajectory.hpp"
+
+class PlayField;
+
+// One evolving set of fields trained headlessly with a fixed time step, with
+// the optional pruning and recording of its experiment. Not thread safe : each
+// population belongs to the thread driving it, which seeds its generator.
+class population
+{
+public:
+    explicit population(const experiment_config& config);
+    ~population();
+
+    population(const population&) = delete;
+    population& operator=(const population&) = delete;
+
+    // false if the environment is unknown
+    bool valid() const
+    { return !m_fields.empty(); }
+
+    // Starts the next generation (the first one breeds from random nets).
+    void advance();
+    // Runs every rollout of the current generation to its end.
+    void evaluate();
+
+    void run_generation()
+    { advance(); evaluate(); }
+
+    std::vector<PlayField*>& fields()
+    { return m_fields; }
+    const PlayField* champion() const;
+
+    // totals so far, seconds excluded
+    const experiment_result& stats() const
+    { return m_stats; }
+
+    // Writes the champion to path with genann_write.
+    bool save_champion(const std::string& path) const;
+    // Writes the first non-dominated front, a line per field : its
+    // objectives then its net as genann_write puts it.
+    bool save_front(const std::string& path) const;
+
+    // Checkpoints the nets of the current generation as started by advance()
+    // (call it before evaluate()) along with the totals, replacing path atomically.
+    // Only the nets are kept : runs that carry more state from one generation
+    // to the next (see unsaved_state()) are not checkpointed.
+    bool save(const std::string& path) const;
+    // Makes a save() the current generation : carry on with evaluate().
+    // Refuses, saying so, when the run has state a checkpoint can't hold.
+    bool load(const std::string& path);
+
+    int generation() const
+    { return m_generation; }
+
+private:
+    // Trains the future first parents on config.imitation_log.
+    void imitate(const experiment_config& config);
+    // Fills m_novelty for the generation just evaluated and grows the archive.
+    void score_novelty();
+    // Runs every field to the end of its episode.
+    void fly();
+    // Finishes every field with its mean score against the others.
+    void play_matches();
+    // Measures the generation just evaluated, logs it and adapts the mutation to it.
+    void track_diversity();
+    // Gaussian mutation's 1/5th success rule : sigma shrinks while fewer than
+    // a fifth of the children beat the parents' generation, grows otherwise.
+    void adapt_mutation_sigma();
+    // Appends the generation just evaluated to the lineage store, opening it first.
+    void record_lineage();
+    // Casts the rays of every lander about to query its net, in one batch.
+    void cast_rays();
+    // Points the fields at their bank scenarios for the given generation.
+    void assign_scenarios(int generation);
+    // What a checkpoint would lose of this run, or null if it keeps it all.
+    const char* unsaved_state() const;
+
+    experiment_config m_config;
+    std::vector<PlayField*> m_fields;
+    std::unique_ptr<generation_pipeline> m_pipeline;
+    std::unique_ptr<evolution_strategy> m_strategy; // replaces the pipeline unless the optimizer is "ga"
+    experiment_result m_stats;
+    int m_generation { -1 };
+
+    trajectory_recorder m_recorder;
+    std::vector<trajectory_buffer> m_recordings;
+    FILE* m_prune_log { nullptr };
+    FILE* m_diversity_log { nullptr };
+    double m_mutated_genes { 1 };             // as adapted to the diversity, rounded for the pipeline
+    float m_parent_threshold { 0 };           // 1/5th rule : score of the worst parent of the last generation
+    std::vector<float> m_scores;              // scratch
+
+    std::unique_ptr<fitness_cache> m_cache; // null unless enabled and the environment is deterministic
+    std::vector<char> m_cacheable;         // per field : flown to its natural end this generation
+    std::vector<char> m_flying;            // scratch, playing before pruning
+
+    std::unique_ptr<matchmaker> m_matchmaker;   // co-evolution only, replaces the episodes
+    std::vector<const genann*> m_genomes;       // scratch
+    std::vector<float> m_match_scores;
+
+    lineage_writer m_lineage;                   // opened on the first generation evaluated
+    std::vector<float> m_lineage_scores;
+    bool m_resumed { false };                   // from a save(), the lineage store is appended to
+
+    std::unique_ptr<novelty_archive> m_archive; // novelty search only
+    std::vector<float> m_novelty;               // of the last evaluated generation
+
+    scenario_bank m_bank;                    // open if the experiment has one
+    std::vector<uint64_t> m_scenarios;       // per field, its index in the bank (the fitness cache key)
+
+    std::shared_ptr<const terrain> m_ground; // lander terrain, shared by the fields
+    std::vector<terrain::ray> m_rays;        // of the current tick
+    std::vector<float> m_ray_distances;
+    std::vector<size_t> m_ray_fields;        // the field of each ray_count rays
+};
+
+#endif // POPULATION_HPP
@@ -0,0 +1,60 @@
+/*
+random.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "random.hpp"
+
+#include <mutex>
+
+#include "genann.h"
+
+std::mt19937 &random_engine()
+{
+    thread_local std::mt19937 engine { std::random_device{}() };
+    return engine;
+}
+
+void seed_random(unsigned seed)
+{
+    random_engine().seed(seed);
+
+    // genann's source is a plain global : installed once, whatever thread seeds first
+    static std::once_flag genann_routed;
+    std::call_once(genann_routed, [] { genann_set_random(random_unit); });
+}
+
+double random_unit()
+{
+    return (double)(random_engine()() - std::mt19937::min()) / (std::mt19937::max() - std::mt19937::min());
+}
+
+int random_int(int max)
+{
+    return std::uniform_int_distribution<int>{0, max - 1}(random_engine());
+}
+
+double random_normal()
+{
+    return std::normal_distribution<double>{}(random_engine());
+}
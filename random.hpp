@@ -0,0 +1,45 @@
+/*
+random.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <random>
+
+// Every thread owns its generator, so concurrent experiments don't fight over
+// (or perturb each other through) the global rand() state.
+std::mt19937& random_engine();
+
+// Seeds the calling thread's generator and routes genann's weight
+// initialization through it.
+void seed_random(unsigned seed);
+
+// uniform in [0; 1]
+double random_unit();
+// uniform in [0; max[
+int    random_int(int max);
+// standard normal
+double random_normal();
+
+#endif // RANDOM_HPP
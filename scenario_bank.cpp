@@ -0,0 +1,237 @@
+/*
+scenario_bank.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "scenario_bank.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SCENARIO_BANK_MMAP
+#endif
+
+#include "common.hpp"
+#include "lander.hpp"
+
+namespace
+{
+
+const char bank_magic[8] = { 'N', 'N', 'S', 'C', 'E', 'N', 'E', '1' };
+
+struct bank_header
+{
+    char     magic[8];
+    char     environment[8]; // zero padded
+    uint64_t count;
+    uint64_t terrain_points;
+};
+
+static_assert(sizeof(scenario) == 24, "scenarios are stored as is");
+
+}
+
+scenario_bank::~scenario_bank()
+{
+    close();
+}
+
+void scenario_bank::close()
+{
+#ifdef SCENARIO_BANK_MMAP
+    if (m_mapping)
+        munmap(const_cast<void*>(m_mapping), m_mapping_size);
+#endif
+    m_mapping = nullptr;
+    m_contents.clear();
+    m_scenarios = nullptr;
+    m_count = m_point_count = 0;
+}
+
+bool scenario_bank::open(const std::string &path)
+{
+    close();
+
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef SCENARIO_BANK_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        perror(path.c_str());
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+    size = info.st_size;
+    void* mapping = size ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    m_mapping      = mapping;
+    m_mapping_size = size;
+    data = (const char*)mapping;
+#else
+    FILE* in = fopen(path.c_str(), "rb");
+    if (!in)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        m_contents.insert(m_contents.end(), buffer, buffer + read);
+    fclose(in);
+    data = m_contents.data();
+    size = m_contents.size();
+#endif
+
+    bank_header header;
+    bool valid = size >= sizeof(header);
+    if (valid)
+    {
+        std::memcpy(&header, data, sizeof(header));
+        const size_t points_size = 2 * sizeof(float);
+        valid = !std::memcmp(header.magic, bank_magic, sizeof(bank_magic)) &&
+                header.terrain_points <= (size - sizeof(header)) / points_size &&
+                header.count <= (size - sizeof(header) - header.terrain_points * points_size) / sizeof(scenario);
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "%s: not a scenario bank\n", path.c_str());
+        close();
+        return false;
+    }
+
+    m_environment.assign(header.environment, strnlen(header.environment, sizeof(header.environment)));
+    m_point_count = header.terrain_points;
+    m_points      = (const float*)(data + sizeof(header));
+    m_count       = header.count;
+    m_scenarios   = (const scenario*)(m_points + 2 * m_point_count);
+    return true;
+}
+
+std::vector<sf::Vector2f> scenario_bank::terrain_points() const
+{
+    std::vector<sf::Vector2f> points;
+    for (size_t i { 0 }; i < m_point_count; ++i)
+        points.emplace_back(m_points[2*i], m_points[2*i + 1]);
+    return points;
+}
+
+bool write_scenario_bank(const std::string &path, const scenario_bank_options &options)
+{
+    if (options.environment != "lander" && options.environment != "pong")
+    {
+        fprintf(stderr, "%s: unknown environment '%s'\n", path.c_str(), options.environment.c_str());
+        return false;
+    }
+
+    std::mt19937 engine(options.seed);
+    auto uniform = [&engine](float low, float high) { return std::uniform_real_distribution<float>{low, high}(engine); };
+    const sf::Vector2f size { (float)gameWidth, (float)gameHeight };
+
+    // rockets start well above the highest hill
+    std::vector<sf::Vector2f> points;
+    float highest_start = size.y * 0.4f;
+    if (options.environment == "lander" && options.terrain)
+    {
+        LanderPlayField probe(sf::Vector2i{gameWidth, gameHeight});
+        points = probe.generate_ground(options.seed, options.terrain_roughness).points();
+        for (const auto& point : points)
+            highest_start = std::min(highest_start, point.y - 150);
+    }
+    const float lowest_start = std::min(size.y * 0.1f, highest_start);
+
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out)
+    {
+        perror(path.c_str());
+        return false;
+    }
+
+    bank_header header {};
+    std::memcpy(header.magic, bank_magic, sizeof(bank_magic));
+    // kept nul terminated : the header is zero initialized
+    std::memcpy(header.environment, options.environment.data(),
+                std::min(options.environment.size(), sizeof(header.environment) - 1));
+    header.count          = options.count;
+    header.terrain_points = points.size();
+    fwrite(&header, sizeof(header), 1, out);
+    for (const auto& point : points)
+    {
+        const float xy[2] = { point.x, point.y };
+        fwrite(xy, sizeof(xy), 1, out);
+    }
+
+    std::vector<scenario> chunk;
+    chunk.reserve(4096);
+    for (uint64_t i { 0 }; i < options.count; ++i)
+    {
+        scenario s {};
+        if (options.environment == "lander")
+        {
+            s.x     = uniform(size.x * 0.15f, size.x * 0.85f);
+            s.y     = uniform(lowest_start, highest_start);
+            s.vx    = uniform(-2, 2);
+            s.vy    = uniform(-1, 2);
+            s.angle = uniform(-60, 60);
+        }
+        else
+        {
+            // not too vertical, as in PongPlayField::restart()
+            s.x = size.x / 2;
+            s.y = size.y / 2 + uniform(-size.y / 4, size.y / 4);
+            do
+                s.angle = uniform(0, 2 * M_PI);
+            while (std::abs(std::cos(s.angle)) < 0.7f);
+            s.seed = engine();
+        }
+
+        chunk.push_back(s);
+        if (chunk.size() == chunk.capacity() || i + 1 == options.count)
+        {
+            fwrite(chunk.data(), sizeof(scenario), chunk.size(), out);
+            chunk.clear();
+        }
+    }
+
+    bool written = !ferror(out);
+    written &= fclose(out) == 0;
+    if (!written)
+        perror(path.c_str());
+    return written;
+}
@@ -0,0 +1,96 @@
+/*
+scenario_bank.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef SCENARIO_BANK_HPP
+#define SCENARIO_BANK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <SFML/System/Vector2.hpp>
+
+// Start state of one episode. Fields read what their environment needs.
+struct scenario
+{
+    float x, y;     // lander : rocket position ; pong : ball position
+    float vx, vy;   // lander : velocity
+    float angle;    // lander : tilt in degrees ; pong : ball direction in radians
+    uint32_t seed;  // pong : the bounces' randomness
+};
+
+// A file of pre-generated scenarios, mapped read-only : opening costs the
+// same whatever its size, processes mapping the same file share its pages,
+// and every worker or island indexing it the same way sees the same
+// episodes. Layout : a header, the terrain points if any (two floats each),
+// then the scenarios, all in the host's byte order.
+class scenario_bank
+{
+public:
+    scenario_bank() = default;
+    ~scenario_bank();
+
+    scenario_bank(const scenario_bank&) = delete;
+    scenario_bank& operator=(const scenario_bank&) = delete;
+
+    // false, with a message on stderr, if path isn't a valid bank
+    bool open(const std::string& path);
+
+    const std::string& environment() const
+    { return m_environment; }
+    size_t size() const
+    { return m_count; }
+    const scenario& operator[](size_t index) const
+    { return m_scenarios[index]; }
+
+    // the ground the scenarios were made for, empty if none
+    std::vector<sf::Vector2f> terrain_points() const;
+
+private:
+    void close();
+
+    const void*     m_mapping { nullptr };
+    size_t          m_mapping_size { 0 };
+    std::vector<char> m_contents; // where the file is read instead of mapped
+    const float*    m_points { nullptr };
+    size_t          m_point_count { 0 };
+    const scenario* m_scenarios { nullptr };
+    size_t          m_count { 0 };
+    std::string     m_environment;
+};
+
+struct scenario_bank_options
+{
+    std::string environment { "lander" }; // lander or pong
+    uint64_t count { 1 << 20 };
+    unsigned seed  { 0 };
+    bool     terrain { false };           // lander : hills, see LanderPlayField::generate_ground()
+    float    terrain_roughness { 200 };
+};
+
+// Draws options.count scenarios from a generator seeded with options.seed and writes them to path.
+bool write_scenario_bank(const std::string& path, const scenario_bank_options& options);
+
+#endif // SCENARIO_BANK_HPP
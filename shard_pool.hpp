@@ -0,0 +1,109 @@
+/*
+shard_pool.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef SHARD_POOL_HPP
+#define SHARD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a job on `count` threads (the caller being the first) and waits for
+// all of them, without creating threads for every batch.
+class shard_pool
+{
+public:
+    explicit shard_pool(unsigned count)
+    {
+        for (unsigned i { 1 }; i < count; ++i)
+            m_threads.emplace_back(&shard_pool::worker, this, i);
+    }
+
+    ~shard_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_start.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    // threads, the caller included
+    unsigned size() const
+    { return (unsigned)m_threads.size() + 1; }
+
+    void run(const std::function<void(unsigned)>& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = &job;
+            m_pending = m_threads.size();
+            ++m_round;
+        }
+        m_start.notify_all();
+
+        job(0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0; });
+    }
+
+private:
+    void worker(unsigned index)
+    {
+        unsigned long long seen = 0;
+        for (;;)
+        {
+            const std::function<void(unsigned)>* job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&] { return m_stopping || m_round != seen; });
+                if (m_stopping)
+                    return;
+                seen = m_round;
+                job = m_job;
+            }
+
+            (*job)(index);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start, m_done;
+    const std::function<void(unsigned)>* m_job { nullptr };
+    size_t m_pending { 0 };
+    unsigned long long m_round { 0 };
+    bool m_stopping { false };
+};
+
+#endif // SHARD_POOL_HPP
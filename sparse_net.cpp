@@ -0,0 +1,130 @@
+/*
+sparse_net.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "sparse_net.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// Where layer h of ann lives, the output layer being h == ann->hidden_layers.
+struct layer_layout
+{
+    int count, fan_in;
+    int source_base, target_base, weight_base; // in the output and weight buffers
+};
+
+layer_layout layout(const genann* ann, int h)
+{
+    layer_layout layer;
+    layer.count       = h == ann->hidden_layers ? ann->outputs : ann->hidden;
+    layer.fan_in      = h == 0 ? ann->inputs : ann->hidden;
+    layer.source_base = h == 0 ? 0 : ann->inputs + (h-1) * ann->hidden;
+    layer.target_base = ann->inputs + h * ann->hidden;
+    layer.weight_base = h == 0 ? 0 : (ann->inputs+1) * ann->hidden + (h-1) * (ann->hidden+1) * ann->hidden;
+    return layer;
+}
+
+}
+
+void sparse_net::compile(const genann *ann)
+{
+    m_rows.clear();
+    m_source.clear();
+    m_weight.clear();
+    m_values.assign(ann->total_neurons, 0.0);
+    m_inputs  = ann->inputs;
+    m_outputs = ann->outputs;
+
+    // a neuron is live if an output depends on it, walking back from the outputs
+    std::vector<char> live(ann->total_neurons, 0);
+    std::fill(live.end() - ann->outputs, live.end(), 1);
+    for (int h { ann->hidden_layers }; h > 0; --h)
+    {
+        auto layer = layout(ann, h);
+        for (int j { 0 }; j < layer.count; ++j)
+        {
+            if (!live[layer.target_base + j])
+                continue;
+            const double* w = ann->weight + layer.weight_base + j * (layer.fan_in + 1) + 1;
+            for (int k { 0 }; k < layer.fan_in; ++k)
+                live[layer.source_base + k] |= w[k] != 0.0;
+        }
+    }
+
+    for (int h { 0 }; h <= ann->hidden_layers; ++h)
+    {
+        if (h == ann->hidden_layers)
+            m_hidden_rows = m_rows.size();
+
+        auto layer = layout(ann, h);
+        for (int j { 0 }; j < layer.count; ++j)
+        {
+            if (!live[layer.target_base + j])
+                continue;
+
+            const double* w = ann->weight + layer.weight_base + j * (layer.fan_in + 1);
+            row r;
+            r.target = layer.target_base + j;
+            r.bias   = w[0];
+            r.first  = (int)m_source.size();
+            for (int k { 0 }; k < layer.fan_in; ++k)
+            {
+                if (w[k+1] == 0.0)
+                    continue;
+                m_source.push_back(layer.source_base + k);
+                m_weight.push_back(w[k+1]);
+            }
+            r.last = (int)m_source.size();
+            m_rows.push_back(r);
+        }
+    }
+}
+
+const double *sparse_net::run(const double *inputs)
+{
+    double* values = m_values.data();
+    std::memcpy(values, inputs, sizeof(double) * m_inputs);
+
+    const int*    source = m_source.data();
+    const double* weight = m_weight.data();
+    for (size_t i { 0 }; i < m_rows.size(); ++i)
+    {
+        const row& r = m_rows[i];
+        double sum = r.bias * -1.0;
+        for (int e { r.first }; e < r.last; ++e)
+            sum += weight[e] * values[source[e]];
+        values[r.target] = i < m_hidden_rows ? genann_act_relu(nullptr, sum) : genann_act_sigmoid(nullptr, sum);
+    }
+
+    return values + m_values.size() - m_outputs;
+}
+
+size_t connection_count(const genann *ann)
+{
+    return ann->total_weights - std::count(ann->weight, ann->weight + ann->total_weights, 0.0);
+}
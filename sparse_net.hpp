@@ -0,0 +1,73 @@
+/*
+sparse_net.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef SPARSE_NET_HPP
+#define SPARSE_NET_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "genann.h"
+
+// A genann net whose zero weights are missing connections, compiled into a
+// topologically sorted list of rows (one per neuron, layer after layer), each
+// with the sources and weights of its remaining connections. Neurons no
+// output depends on anymore are left out. run() gives the outputs genann_run
+// would, summed in the same order, at a cost proportional to the connections
+// left : pruned controllers fly faster than dense ones.
+class sparse_net
+{
+public:
+    // Compiles ann as it is now : recompile after any change to its weights.
+    void compile(const genann* ann);
+
+    // The outputs, valid until the next run().
+    const double* run(const double* inputs);
+
+    size_t connections() const
+    { return m_source.size(); }
+    size_t neurons() const
+    { return m_rows.size(); }
+
+private:
+    struct row
+    {
+        int    target; // in m_values, laid out like genann's output buffer
+        int    first, last; // range in m_source and m_weight
+        double bias;
+    };
+
+    std::vector<row>    m_rows;   // hidden ones first
+    size_t              m_hidden_rows { 0 };
+    std::vector<int>    m_source; // in m_values
+    std::vector<double> m_weight;
+    std::vector<double> m_values; // inputs then neuron outputs
+    int m_inputs  { 0 };
+    int m_outputs { 0 };
+};
+
+// Weights of ann that aren't zero, biases included.
+size_t connection_count(const genann* ann);
+
+#endif // SPARSE_NET_HPP
@@ -0,0 +1,326 @@
+/*
+stats_server.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "stats_server.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::is_trivially_copyable<live_stats>::value, "live_stats is published word by word");
+
+namespace
+{
+
+const int poll_interval_ms = 200;
+
+void append_string(std::string& out, const std::string& text)
+{
+    out += '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+            out += c;
+    }
+    out += '"';
+}
+
+void append_number(std::string& out, const char* key, double value)
+{
+    // JSON has no inf nor nan : a run that has not scored yet has a -inf best
+    char buffer[64];
+    if (std::isfinite(value))
+        snprintf(buffer, sizeof(buffer), "\"%s\":%.6g,", key, value);
+    else
+        snprintf(buffer, sizeof(buffer), "\"%s\":null,", key);
+    out += buffer;
+}
+
+void append_count(std::string& out, const char* key, unsigned long long value)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "\"%s\":%llu,", key, value);
+    out += buffer;
+}
+
+double process_cpu_seconds()
+{
+#ifndef _WIN32
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+    return 0;
+}
+
+}
+
+void stats_slot::publish(const live_stats &stats)
+{
+    uint64_t words[word_count] {};
+    std::memcpy(words, &stats, sizeof(stats));
+
+    // odd while the words are being written
+    const uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i { 0 }; i < word_count; ++i)
+        m_words[i].store(words[i], std::memory_order_relaxed);
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+live_stats stats_slot::read() const
+{
+    uint64_t words[word_count];
+    for (;;)
+    {
+        const uint64_t before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i { 0 }; i < word_count; ++i)
+            words[i] = m_words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) == before)
+            break;
+    }
+
+    live_stats stats;
+    std::memcpy(&stats, words, sizeof(stats));
+    return stats;
+}
+
+stats_board::stats_board(const std::vector<std::string> &names, unsigned workers)
+    : m_names(names), m_slots(new stats_slot[names.size()]), m_workers(workers), m_start(std::chrono::steady_clock::now())
+{
+}
+
+stats_server::~stats_server()
+{
+    stop();
+}
+
+bool stats_server::start(const stats_board &board, unsigned short port)
+{
+    stop();
+#ifdef _WIN32
+    (void)board; (void)port;
+    fprintf(stderr, "the stats server needs posix sockets\n");
+    return false;
+#else
+    m_listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listener < 0)
+    {
+        perror("stats server socket");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(m_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // local only : there is no authentication
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(m_listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(m_listener, 8) < 0)
+    {
+        perror("stats server bind");
+        close(m_listener);
+        m_listener = -1;
+        return false;
+    }
+
+    m_board = &board;
+    m_last_cpu = process_cpu_seconds();
+    m_last_request = std::chrono::steady_clock::now();
+    m_stopping = false;
+    m_thread = std::thread(&stats_server::serve, this);
+    fprintf(stderr, "live stats on http://127.0.0.1:%u/\n", port);
+
+    return true;
+#endif
+}
+
+void stats_server::stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_stopping = true;
+    m_thread.join();
+#ifndef _WIN32
+    close(m_listener);
+#endif
+    m_listener = -1;
+}
+
+void stats_server::serve()
+{
+#ifndef _WIN32
+    // woken up regularly to notice stop()
+    pollfd listener { m_listener, POLLIN, 0 };
+    while (!m_stopping)
+    {
+        if (poll(&listener, 1, poll_interval_ms) <= 0)
+            continue;
+
+        int client = accept(m_listener, nullptr, nullptr);
+        if (client < 0)
+            continue;
+
+        // a client that doesn't send its request is not waited for long
+        timeval timeout { 1, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        respond(client);
+        close(client);
+    }
+#endif
+}
+
+void stats_server::respond(int client)
+{
+#ifndef _WIN32
+    // the request line is all that matters, the headers are read and ignored
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+    {
+        ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+            break;
+        request.append(buffer, received);
+    }
+
+    std::string status = "200 OK", body;
+    if (request.compare(0, 4, "GET ") != 0)
+    {
+        status = "405 Method Not Allowed";
+        body = "{\"error\":\"GET only\"}";
+    }
+    else
+    {
+        auto path = request.substr(4, request.find(' ', 4) - 4);
+        if (path == "/" || path == "/stats")
+            body = json();
+        else
+        {
+            status = "404 Not Found";
+            body = "{\"error\":\"try /stats\"}";
+        }
+    }
+
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: application/json\r\n"
+                           "Cache-Control: no-store\r\n"
+                           "Connection: close\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    for (size_t sent { 0 }; sent < response.size();)
+    {
+        ssize_t written = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0)
+            break;
+        sent += written;
+    }
+#else
+    (void)client;
+#endif
+}
+
+std::string stats_server::json()
+{
+    auto now = std::chrono::steady_clock::now();
+    const double cpu = process_cpu_seconds();
+    const double wall = std::chrono::duration<double>(now - m_last_request).count();
+    const unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    // busy share of every hardware thread since the previous request
+    const double utilization = wall > 0 ? (cpu - m_last_cpu) / (wall * hardware_threads) : 0;
+    m_last_cpu = cpu;
+    m_last_request = now;
+
+    std::string out = "{";
+    append_number(out, "uptime_seconds", std::chrono::duration<double>(now - m_board->start()).count());
+    append_count(out, "hardware_threads", hardware_threads);
+    append_count(out, "workers", m_board->workers());
+
+    std::string runs;
+    size_t busy = 0;
+    for (size_t i { 0 }; i < m_board->size(); ++i)
+    {
+        const auto stats = m_board->slot(i).read();
+        busy += stats.state == live_stats::running;
+
+        runs += "{\"name\":";
+        append_string(runs, m_board->name(i));
+        runs += stats.state == live_stats::pending ? ",\"state\":\"pending\"," :
+                stats.state == live_stats::running ? ",\"state\":\"running\"," : ",\"state\":\"finished\",";
+        append_number(runs, "generation", stats.generation);
+        append_number(runs, "best_score", stats.best_score);
+        append_number(runs, "generation_best", stats.final_best);
+        append_number(runs, "generation_mean", stats.final_mean);
+        append_count(runs, "evaluations", stats.evaluations);
+        append_number(runs, "evaluations_per_second", stats.seconds > 0 ? stats.evaluations / stats.seconds : 0);
+        append_count(runs, "ticks", stats.ticks);
+        append_number(runs, "seconds", stats.seconds);
+        runs += "\"phases\":{";
+        append_number(runs, "breed_seconds", stats.breed_seconds);
+        append_number(runs, "evaluate_seconds", stats.evaluate_seconds);
+        runs.back() = '}';
+        runs += "},";
+    }
+    if (!runs.empty())
+        runs.pop_back();
+
+    append_count(out, "busy_workers", busy);
+    append_number(out, "worker_utilization", m_board->workers() ? (double)busy / m_board->workers() : 0);
+    append_number(out, "cpu_utilization", utilization);
+    out += "\"runs\":[" + runs + "]}";
+
+    return out;
+}
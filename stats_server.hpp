@@ -0,0 +1,128 @@
+/*
+stats_server.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef STATS_SERVER_HPP
+#define STATS_SERVER_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+// Progress of one run as of its last generation.
+struct live_stats
+{
+    enum : int32_t { pending, running, finished };
+
+    int32_t state        { pending };
+    int32_t generation   { -1 };
+    double  best_score   { 0 }; // over the run
+    double  final_best   { 0 }; // of the last generation
+    double  final_mean   { 0 };
+    double  seconds      { 0 }; // since the run started
+    double  breed_seconds    { 0 }; // last generation : advance(), breeding and swapping nets in
+    double  evaluate_seconds { 0 }; // last generation : evaluate(), the rollouts and their logs
+    uint64_t evaluations { 0 };
+    uint64_t ticks       { 0 };
+};
+
+// Where a run publishes its live_stats, once per generation, for any thread
+// to read. A seqlock : publish() is a few relaxed stores and never waits,
+// read() retries while a publish is under way.
+class stats_slot
+{
+public:
+    stats_slot()
+    { publish(live_stats{}); }
+
+    void publish(const live_stats& stats);
+    live_stats read() const;
+
+private:
+    static const size_t word_count = (sizeof(live_stats) + 7) / 8;
+
+    std::atomic<uint64_t> m_sequence { 0 };
+    std::atomic<uint64_t> m_words[word_count] {};
+};
+
+// A slot per run, named before any of them starts.
+class stats_board
+{
+public:
+    stats_board(const std::vector<std::string>& names, unsigned workers);
+
+    size_t size() const
+    { return m_names.size(); }
+    const std::string& name(size_t i) const
+    { return m_names[i]; }
+    stats_slot& slot(size_t i)
+    { return m_slots[i]; }
+    const stats_slot& slot(size_t i) const
+    { return m_slots[i]; }
+    // threads the runs share
+    unsigned workers() const
+    { return m_workers; }
+    std::chrono::steady_clock::time_point start() const
+    { return m_start; }
+
+private:
+    std::vector<std::string> m_names;
+    std::unique_ptr<stats_slot[]> m_slots;
+    unsigned m_workers;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Serves a board as json on http://127.0.0.1:port/ (and /stats) from a
+// thread of its own, reading the slots only when asked : training pays for
+// the publish() calls alone.
+class stats_server
+{
+public:
+    stats_server() = default;
+    stats_server(const stats_server&) = delete;
+    stats_server& operator=(const stats_server&) = delete;
+    ~stats_server();
+
+    bool start(const stats_board& board, unsigned short port);
+    void stop();
+
+private:
+    void serve();
+    void respond(int client);
+    std::string json();
+
+    const stats_board* m_board { nullptr };
+    int m_listener { -1 };
+    std::atomic<bool> m_stopping { false };
+    std::thread m_thread;
+
+    // cpu utilization since the previous request
+    double m_last_cpu { 0 };
+    std::chrono::steady_clock::time_point m_last_request;
+};
+
+#endif // STATS_SERVER_HPP
@@ -0,0 +1,151 @@
+/*
+sweep.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "sweep.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <memory>
+
+#include "stats_server.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+
+void pin_to_core(std::thread& thread, unsigned core)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+    (void)thread; (void)core;
+#endif
+}
+
+live_stats final_stats(const experiment_result& result)
+{
+    live_stats stats;
+    stats.state       = live_stats::finished;
+    stats.generation  = result.generations - 1;
+    stats.best_score  = result.best_score;
+    stats.final_best  = result.final_best;
+    stats.final_mean  = result.final_mean;
+    stats.seconds     = result.seconds;
+    stats.evaluations = result.evaluations;
+    stats.ticks       = result.ticks;
+    return stats;
+}
+
+}
+
+std::vector<experiment_result> run_sweep(const std::vector<experiment_config> &experiments, const sweep_options &options)
+{
+    std::vector<experiment_result> results(experiments.size());
+
+    unsigned hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned thread_count = options.threads ? options.threads : hardware_threads;
+    thread_count = std::min<unsigned>(thread_count, experiments.size());
+
+    std::atomic<size_t> next_experiment { 0 };
+    std::mutex progress_mutex;
+    size_t finished = 0;
+
+    std::unique_ptr<stats_board> board;
+    stats_server server;
+    if (options.stats_port)
+    {
+        std::vector<std::string> names;
+        for (const auto& experiment : experiments)
+            names.push_back(experiment.name);
+        board.reset(new stats_board(names, thread_count));
+        if (!server.start(*board, options.stats_port))
+            board.reset();
+    }
+
+    auto worker = [&]
+    {
+        size_t index;
+        while ((index = next_experiment++) < experiments.size())
+        {
+            stats_slot* live = board ? &board->slot(index) : nullptr;
+            if (live)
+            {
+                live_stats started;
+                started.state = live_stats::running;
+                live->publish(started);
+            }
+
+            results[index] = run_experiment(experiments[index], live);
+            if (live)
+                live->publish(final_stats(results[index]));
+
+            if (options.progress)
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex);
+                ++finished;
+                if (results[index].failed)
+                    fprintf(stderr, "[%zu/%zu] %s : failed\n", finished, experiments.size(), results[index].name.c_str());
+                else
+                    fprintf(stderr, "[%zu/%zu] %s : best %.3f in %.1fs\n", finished, experiments.size(),
+                            results[index].name.c_str(), results[index].best_score, results[index].seconds);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i { 0 }; i < thread_count; ++i)
+    {
+        threads.emplace_back(worker);
+        if (options.pin)
+            pin_to_core(threads.back(), i % hardware_threads);
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    return results;
+}
+
+void write_summary(FILE *out, const std::vector<experiment_result> &results)
+{
+    fprintf(out, "name,generations,best_score,final_best,final_mean,evaluations,ticks,pruned,early_bred,cache_hits,cache_hit_rate,seconds,ticks_per_second\n");
+    for (const auto& result : results)
+    {
+        auto lookups = result.cache_hits + result.cache_misses;
+        fprintf(out, "%s,%d,%.3f,%.3f,%.3f,%llu,%llu,%llu,%llu,%llu,%.3f,%.3f,%.0f\n",
+                result.name.c_str(), result.generations, result.best_score, result.final_best, result.final_mean,
+                result.evaluations, result.ticks, result.pruned, result.early_bred, result.cache_hits,
+                lookups ? (double)result.cache_hits / lookups : 0.0, result.seconds, result.seconds > 0 ? result.ticks / result.seconds : 0.0);
+    }
+}
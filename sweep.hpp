@@ -0,0 +1,48 @@
+/*
+sweep.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <cstdio>
+#include <vector>
+
+#include "experiment.hpp"
+
+struct sweep_options
+{
+    unsigned threads  { 0 };    // 0 : one per hardware thread
+    bool     pin      { true }; // bind worker n to core n
+    bool     progress { true }; // one line on stderr per finished experiment
+    unsigned short stats_port { 0 }; // if set, live progress is served on localhost, see stats_server.hpp
+};
+
+// Runs every experiment on a pool of worker threads, each worker pulling the
+// next pending experiment. Results come back in the order of the input.
+std::vector<experiment_result> run_sweep(const std::vector<experiment_config>& experiments, const sweep_options& options);
+
+// One csv line per experiment, with a header.
+void write_summary(FILE* out, const std::vector<experiment_result>& results);
+
+#endif // SWEEP_HPP
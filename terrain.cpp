@@ -0,0 +1,223 @@
+/*
+terrain.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "terrain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+constexpr float terrain::cell_size;
+
+namespace
+{
+
+float cross(sf::Vector2f a, sf::Vector2f b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+}
+
+void terrain::generate(unsigned seed, sf::Vector2f size, float ground_y, float roughness, float pad_left, float pad_right)
+{
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> unit(-0.5f, 0.5f);
+
+    // midpoint displacement, halving the amplitude at every level
+    const int intervals = 64;
+    std::vector<float> heights(intervals + 1);
+    heights[0]         = ground_y - roughness * (0.5f + unit(engine));
+    heights[intervals] = ground_y - roughness * (0.5f + unit(engine));
+    float amplitude = roughness;
+    for (int step { intervals }; step > 1; step /= 2, amplitude /= 2)
+    {
+        for (int i { step / 2 }; i < intervals; i += step)
+            heights[i] = (heights[i - step/2] + heights[i + step/2]) / 2 + amplitude * unit(engine);
+    }
+
+    std::vector<sf::Vector2f> points;
+    for (int i { 0 }; i <= intervals; ++i)
+    {
+        float x = size.x * i / intervals;
+        if (x >= pad_left && x <= pad_right)
+            continue;
+        if (x > pad_right && (points.empty() || points.back().x < pad_left))
+        {
+            points.emplace_back(pad_left, ground_y);
+            points.emplace_back(pad_right, ground_y);
+        }
+        points.emplace_back(x, std::min(std::max(heights[i], ground_y - roughness), size.y));
+    }
+
+    set_points(points);
+}
+
+void terrain::set_points(const std::vector<sf::Vector2f> &points)
+{
+    m_points = points;
+    m_segments.clear();
+    for (size_t i { 1 }; i < points.size(); ++i)
+        m_segments.push_back({points[i-1], points[i]});
+
+    m_columns = m_rows = 0;
+    m_cell_start.assign(1, 0);
+    m_cell_segments.clear();
+    if (m_segments.empty())
+        return;
+
+    sf::Vector2f low = points[0], high = points[0];
+    for (const auto& point : points)
+    {
+        low.x  = std::min(low.x, point.x);  low.y  = std::min(low.y, point.y);
+        high.x = std::max(high.x, point.x); high.y = std::max(high.y, point.y);
+    }
+    m_origin  = low;
+    m_columns = (int)((high.x - low.x) / cell_size) + 1;
+    m_rows    = (int)((high.y - low.y) / cell_size) + 1;
+
+    // cells overlapped by the bounding box of each segment, counted then filled
+    auto cells_of = [this](const segment& s, int& x0, int& x1, int& y0, int& y1)
+    {
+        x0 = (int)((std::min(s.a.x, s.b.x) - m_origin.x) / cell_size);
+        x1 = (int)((std::max(s.a.x, s.b.x) - m_origin.x) / cell_size);
+        y0 = (int)((std::min(s.a.y, s.b.y) - m_origin.y) / cell_size);
+        y1 = (int)((std::max(s.a.y, s.b.y) - m_origin.y) / cell_size);
+    };
+
+    m_cell_start.assign(m_columns * m_rows + 1, 0);
+    int x0, x1, y0, y1;
+    for (const auto& s : m_segments)
+    {
+        cells_of(s, x0, x1, y0, y1);
+        for (int y { y0 }; y <= y1; ++y)
+            for (int x { x0 }; x <= x1; ++x)
+                ++m_cell_start[y * m_columns + x + 1];
+    }
+    for (size_t i { 1 }; i < m_cell_start.size(); ++i)
+        m_cell_start[i] += m_cell_start[i-1];
+
+    m_cell_segments.resize(m_cell_start.back());
+    std::vector<int> fill(m_cell_start.begin(), m_cell_start.end() - 1);
+    for (size_t i { 0 }; i < m_segments.size(); ++i)
+    {
+        cells_of(m_segments[i], x0, x1, y0, y1);
+        for (int y { y0 }; y <= y1; ++y)
+            for (int x { x0 }; x <= x1; ++x)
+                m_cell_segments[fill[y * m_columns + x]++] = (int)i;
+    }
+}
+
+float terrain::raycast(const ray &r) const
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    float best = r.range;
+    if (m_segments.empty())
+        return best;
+
+    // the part of the ray within the grid
+    float t_enter = 0, t_exit = r.range;
+    const float o[2]    = { r.origin.x, r.origin.y };
+    const float d[2]    = { r.direction.x, r.direction.y };
+    const float low[2]  = { m_origin.x, m_origin.y };
+    const float high[2] = { m_origin.x + m_columns * cell_size, m_origin.y + m_rows * cell_size };
+    for (int axis { 0 }; axis < 2; ++axis)
+    {
+        if (d[axis] == 0)
+        {
+            if (o[axis] < low[axis] || o[axis] > high[axis])
+                return best;
+            continue;
+        }
+        float t0 = (low[axis] - o[axis]) / d[axis], t1 = (high[axis] - o[axis]) / d[axis];
+        t_enter = std::max(t_enter, std::min(t0, t1));
+        t_exit  = std::min(t_exit,  std::max(t0, t1));
+    }
+    if (t_enter > t_exit)
+        return best;
+
+    int cell[2], step[2];
+    float next[2], delta[2];
+    const int size[2] = { m_columns, m_rows };
+    for (int axis { 0 }; axis < 2; ++axis)
+    {
+        float p = o[axis] + d[axis] * t_enter;
+        cell[axis] = std::min(std::max((int)((p - low[axis]) / cell_size), 0), size[axis] - 1);
+        step[axis] = d[axis] > 0 ? 1 : -1;
+        if (d[axis] == 0)
+        {
+            next[axis] = delta[axis] = infinity;
+            continue;
+        }
+        float boundary = low[axis] + (cell[axis] + (d[axis] > 0)) * cell_size;
+        next[axis]  = (boundary - o[axis]) / d[axis];
+        delta[axis] = cell_size / std::abs(d[axis]);
+    }
+
+    for (;;)
+    {
+        const int index = cell[1] * m_columns + cell[0];
+        for (int i { m_cell_start[index] }; i < m_cell_start[index + 1]; ++i)
+        {
+            const segment& s = m_segments[m_cell_segments[i]];
+            const sf::Vector2f edge = s.b - s.a, to_start = s.a - r.origin;
+            const float denominator = cross(r.direction, edge);
+            if (denominator == 0)
+                continue;
+            const float t = cross(to_start, edge) / denominator;
+            const float u = cross(to_start, r.direction) / denominator;
+            if (t >= 0 && u >= 0 && u <= 1 && t < best)
+                best = t;
+        }
+
+        // a hit before the cell's exit can't be beaten by the cells after it
+        const int axis = next[0] < next[1] ? 0 : 1;
+        if (best <= next[axis] || next[axis] > t_exit)
+            break;
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= size[axis])
+            break;
+        next[axis] += delta[axis];
+    }
+
+    return best;
+}
+
+void terrain::raycast(const ray *rays, size_t count, float *distances) const
+{
+    for (size_t i { 0 }; i < count; ++i)
+        distances[i] = raycast(rays[i]);
+}
+
+bool terrain::crosses(sf::Vector2f a, sf::Vector2f b) const
+{
+    const sf::Vector2f path = b - a;
+    const float length = std::sqrt(path.x*path.x + path.y*path.y);
+    if (length == 0)
+        return false;
+
+    return raycast({a, path / length, length}) < length;
+}
@@ -0,0 +1,82 @@
+/*
+terrain.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef TERRAIN_HPP
+#define TERRAIN_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <SFML/System/Vector2.hpp>
+
+// Ground made of line segments, indexed by a uniform grid : each cell lists
+// the segments whose bounding box overlaps it, and rays walk the cells they
+// cross in order (Amanatides & Woo), so a cast only tests the segments near
+// its path and stops at the first cell holding a hit.
+class terrain
+{
+public:
+    struct ray
+    {
+        sf::Vector2f origin;
+        sf::Vector2f direction; // unit length
+        float        range;
+    };
+
+    // Random hills across size.x, their height at most roughness above
+    // ground_y and never below size.y, flat at ground_y over [pad_left; pad_right].
+    // Only draws from a generator of its own, seeded with seed.
+    void generate(unsigned seed, sf::Vector2f size, float ground_y, float roughness, float pad_left, float pad_right);
+
+    // Replaces the segments, a polyline through points, and rebuilds the grid.
+    void set_points(const std::vector<sf::Vector2f>& points);
+
+    // Distance along the ray to the first segment it meets, its range if none.
+    float raycast(const ray& r) const;
+    // The same for count rays at once.
+    void  raycast(const ray* rays, size_t count, float* distances) const;
+    // True if the segment from a to b crosses the ground.
+    bool  crosses(sf::Vector2f a, sf::Vector2f b) const;
+
+    const std::vector<sf::Vector2f>& points() const
+    { return m_points; }
+
+    static constexpr float cell_size = 32.f;
+
+private:
+    struct segment
+    {
+        sf::Vector2f a, b;
+    };
+
+    std::vector<sf::Vector2f> m_points;
+    std::vector<segment> m_segments;
+
+    sf::Vector2f m_origin; // of cell (0, 0)
+    int m_columns { 0 }, m_rows { 0 };
+    std::vector<int> m_cell_start; // m_columns * m_rows + 1, into m_cell_segments
+    std::vector<int> m_cell_segments;
+};
+
+#endif // TERRAIN_HPP
@@ -0,0 +1,313 @@
+/*
+trainer.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "trainer.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "playfield.hpp"
+#include "genetic_operations.hpp"
+#include "random.hpp"
+#include "pareto.hpp"
+
+#include "genann.h"
+
+namespace
+{
+
+// Indices of the parent_count best fields, ties going to the lowest index.
+// Fields are compared on fitness if given (one value each), else on their score.
+// Returns how many fields were considered.
+size_t rank_best(const std::vector<PlayField*>& fields, bool finished_only, size_t best[parent_count],
+                 const std::vector<float>* fitness = nullptr)
+{
+    auto value = [&](size_t i) { return fitness ? (*fitness)[i] : fields[i]->score(); };
+
+    size_t considered = 0;
+    for (size_t i { 0 }; i < fields.size(); ++i)
+    {
+        if (finished_only && fields[i]->playing())
+            continue;
+
+        float score = value(i);
+        size_t rank = std::min(considered, parent_count);
+        for (; rank > 0 && value(best[rank-1]) < score; --rank)
+        {
+            if (rank < parent_count)
+                best[rank] = best[rank-1];
+        }
+        if (rank < parent_count)
+            best[rank] = i;
+        ++considered;
+    }
+
+    return considered;
+}
+
+// Whether the best finished fields are the final parents already.
+bool parents_settled(const std::vector<PlayField*>& fields, size_t parents[parent_count])
+{
+    // scores of the finished fields are final
+    if (rank_best(fields, true, parents) < parent_count)
+        return false;
+
+    float threshold = fields[parents[parent_count-1]]->score();
+    return std::none_of(fields.begin(), fields.end(), [threshold](const PlayField* field)
+    { return field->playing() && field->score_upper_bound() >= threshold; });
+}
+
+// Child of the two parents, mutated by whichever operator params ask for.
+neural_net child_of(const neural_net& parent_1, const neural_net& parent_2, const ga_params& params)
+{
+    auto child = crossover(parent_1, parent_2);
+    return params.mutation.gaussian ? mutate_gaussian(child, params.mutation_factor, params.mutation)
+                                    : mutate(child, params.mutation_factor, params.mutated_genes);
+}
+
+std::vector<neural_net> breed_from(const neural_net& parent_1, const neural_net& parent_2, size_t count, const ga_params& params)
+{
+    size_t bred_count = count - std::min(params.random_immigrants, count);
+    std::vector<neural_net> nets;
+    for (size_t i { 0 }; i < bred_count; ++i)
+        nets.push_back(child_of(parent_1, parent_2, params));
+    for (auto& net : nets)
+        net = mutate_topology(net, params.connection_removal, params.connection_addition);
+
+    // the last ones start over from random nets
+    for (size_t i { bred_count }; i < count; ++i)
+        nets.emplace_back(nn_clone(parent_1));
+
+    return nets;
+}
+
+std::vector<neural_net> breed_pareto(const std::vector<PlayField*>& fields, const ga_params& params)
+{
+    std::vector<int> front;
+    auto order = pareto_ranking(fields, front);
+    std::vector<size_t> position(fields.size());
+    for (size_t i { 0 }; i < order.size(); ++i)
+        position[order[i]] = i;
+
+    auto tournament = [&]() -> const neural_net&
+    {
+        size_t a = random_int((int)fields.size()), b = random_int((int)fields.size());
+        return fields[position[a] < position[b] ? a : b]->net;
+    };
+
+    const size_t count = fields.size();
+    const size_t immigrants = std::min(params.random_immigrants, count);
+    const size_t elites = std::min(count / 2, count - immigrants);
+
+    std::vector<neural_net> nets;
+    for (size_t i { 0 }; i < elites; ++i)
+    {
+        nets.emplace_back(nn_clone(fields[order[i]]->net));
+        std::copy(fields[order[i]]->net.nn->weight, fields[order[i]]->net.nn->weight + nets.back().nn->total_weights,
+                  nets.back().nn->weight);
+        nets.back().mutation_step = fields[order[i]]->net.mutation_step;
+    }
+    while (nets.size() < count - immigrants)
+    {
+        const auto& parent_1 = tournament();
+        const auto& parent_2 = tournament();
+        nets.push_back(mutate_topology(child_of(parent_1, parent_2, params),
+                                       params.connection_removal, params.connection_addition));
+    }
+    while (nets.size() < count)
+        nets.emplace_back(nn_clone(fields[0]->net));
+
+    return nets;
+}
+
+}
+
+std::vector<size_t> pareto_ranking(const std::vector<PlayField *> &fields, std::vector<int> &front)
+{
+    const int dimension = fields[0]->objective_count();
+    std::vector<float> objectives(fields.size() * dimension), violation(fields.size());
+    for (size_t i { 0 }; i < fields.size(); ++i)
+    {
+        fields[i]->objectives(&objectives[i * dimension]);
+        violation[i] = fields[i]->violation();
+    }
+
+    std::vector<float> crowding;
+    non_dominated_sort(objectives, dimension, &violation, front);
+    crowding_distance(objectives, dimension, front, crowding);
+
+    std::vector<size_t> order(fields.size());
+    for (size_t i { 0 }; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+    {
+        if (front[lhs] != front[rhs])
+            return front[lhs] < front[rhs];
+        if (crowding[lhs] != crowding[rhs])
+            return crowding[lhs] > crowding[rhs];
+        return lhs < rhs;
+    });
+    return order;
+}
+
+std::vector<neural_net> breed_generation(const std::vector<PlayField *> &fields, const ga_params &params)
+{
+    assert(fields.size() >= 2);
+
+    if (params.multi_objective)
+        return breed_pareto(fields, params);
+
+    size_t parents[parent_count];
+    rank_best(fields, false, parents);
+
+    //field_ptrs = select(field_ptrs, 2);
+
+    return breed_from(fields[parents[0]]->net, fields[parents[1]]->net, fields.size(), params);
+}
+
+std::vector<neural_net> breed_generation(const std::vector<PlayField *> &fields, const std::vector<float> &fitness, const ga_params &params)
+{
+    assert(fields.size() >= 2 && fitness.size() == fields.size());
+
+    size_t parents[parent_count];
+    rank_best(fields, false, parents, &fitness);
+
+    return breed_from(fields[parents[0]]->net, fields[parents[1]]->net, fields.size(), params);
+}
+
+void start_generation(std::vector<PlayField *> &fields, std::vector<neural_net> &nets)
+{
+    assert(nets.size() == fields.size());
+
+    for (size_t i { 0 }; i < fields.size(); ++i)
+    {
+        auto* field = fields[i];
+
+        nn_free(field->net);
+        field->net = nets[i];
+        field->restart();
+        // (re)start the game
+        field->set_playing(true);
+    }
+}
+
+void next_generation(std::vector<PlayField *> &fields, const ga_params &params)
+{
+    auto nets = breed_generation(fields, params);
+    start_generation(fields, nets);
+}
+
+generation_pipeline::generation_pipeline(const ga_params &params)
+    : m_params(params)
+{
+}
+
+generation_pipeline::~generation_pipeline()
+{
+    if (m_offspring.valid())
+    {
+        for (auto& net : m_offspring.get())
+            nn_free(net);
+    }
+}
+
+void generation_pipeline::update(const std::vector<PlayField *> &fields)
+{
+    size_t parents[parent_count];
+    if (m_params.multi_objective || m_offspring.valid() || !parents_settled(fields, parents))
+        return;
+
+    start_breeding(fields[parents[0]]->net, fields[parents[1]]->net, fields.size());
+    ++m_early_count;
+}
+
+void generation_pipeline::advance(std::vector<PlayField *> &fields, const std::vector<float> *fitness)
+{
+    if (fitness)
+    {
+        auto nets = breed_generation(fields, *fitness, m_params);
+        start_generation(fields, nets);
+        return;
+    }
+
+    if (m_params.multi_objective)
+    {
+        auto nets = breed_generation(fields, m_params);
+        start_generation(fields, nets);
+        return;
+    }
+
+    if (!m_offspring.valid())
+    {
+        size_t parents[parent_count];
+        rank_best(fields, false, parents);
+        start_breeding(fields[parents[0]]->net, fields[parents[1]]->net, fields.size());
+    }
+
+    auto nets = m_offspring.get();
+    start_generation(fields, nets);
+}
+
+void generation_pipeline::start_breeding(const neural_net &parent_1, const neural_net &parent_2, size_t count)
+{
+    unsigned seed = random_engine()();
+    ga_params params = m_params;
+
+    // the parents are finished, their nets stay untouched until advance()
+    m_offspring = std::async(std::launch::async, [parent_1, parent_2, count, params, seed]
+    {
+        seed_random(seed);
+        return breed_from(parent_1, parent_2, count, params);
+    });
+}
+
+size_t prune_hopeless(std::vector<PlayField *> &fields, int generation, FILE *log)
+{
+    // scores of the finished fields are final
+    size_t best[parent_count];
+    if (rank_best(fields, true, best) < parent_count)
+        return 0;
+
+    const float threshold = fields[best[parent_count-1]]->score();
+
+    size_t pruned = 0;
+    for (size_t i { 0 }; i < fields.size(); ++i)
+    {
+        auto* field = fields[i];
+        if (!field->playing())
+            continue;
+
+        float bound = field->score_upper_bound();
+        if (bound < threshold)
+        {
+            field->set_playing(false);
+            ++pruned;
+            if (log)
+                fprintf(log, "%d,%zu,%.3f,%.3f,%.3f\n", generation, i, field->score(), bound, threshold);
+        }
+    }
+
+    return pruned;
+}
@@ -0,0 +1,118 @@
+/*
+trainer.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef TRAINER_HPP
+#define TRAINER_HPP
+
+#include <algorithm>
+#include <vector>
+#include <future>
+#include <cstddef>
+#include <cstdio>
+
+#include "network.hpp"
+#include "mutation.hpp"
+
+class PlayField;
+
+struct ga_params
+{
+    double mutation_factor   { 0.1 }; // chance for a child to skip mutation, see mutate()
+    int    mutated_genes     { 1 };   // weights replaced in a mutated child
+    size_t random_immigrants { 3 };   // trailing fields keeping the fresh random net from reset()
+    bool   multi_objective   { false }; // pareto selection on PlayField::objectives(), see breed_generation()
+    double connection_removal  { 0 };   // chance for a child to lose a connection, see mutate_topology()
+    double connection_addition { 0 };   // chance for a child to regain one
+    mutation_params mutation;           // gaussian perturbation instead of mutate(), see mutate_gaussian()
+};
+
+// next_generation breeds the two best fields
+const size_t parent_count = 2;
+
+// Nets of a whole new generation : children of the two best fields (ties go
+// to the lowest index), followed by random_immigrants fresh random nets.
+//
+// With multi_objective, fields are ordered by non-dominated front then by
+// crowding distance (NSGA-II) : the better half is carried over as is, and
+// every child has its own two parents, each the better of two random fields.
+std::vector<neural_net> breed_generation(const std::vector<PlayField*>& fields, const ga_params& params);
+
+// The same, the parents being the two best by fitness (a value per field) rather than by score.
+std::vector<neural_net> breed_generation(const std::vector<PlayField*>& fields, const std::vector<float>& fitness, const ga_params& params);
+
+// Indices of the fields in the multi-objective order above, and their fronts.
+std::vector<size_t> pareto_ranking(const std::vector<PlayField*>& fields, std::vector<int>& front);
+
+// Hands each field its new net, freeing the old one, and restarts it.
+void start_generation(std::vector<PlayField*>& fields, std::vector<neural_net>& nets);
+
+// Ranks the fields by score, breeds the two best and restarts every field with the offspring.
+void next_generation(std::vector<PlayField*>& fields, const ga_params& params);
+
+// Breeds the next generation on a worker thread as soon as its parents are
+// known for sure, i.e. when no rollout still running can beat the second
+// best finished one (see score_upper_bound()) ; multi-objective generations
+// are bred at their end. The generation switch then only swaps nets in. The
+// worker uses a seed drawn from the caller's generator, so runs stay
+// reproducible whenever the breeding starts.
+class generation_pipeline
+{
+public:
+    explicit generation_pipeline(const ga_params& params);
+    ~generation_pipeline();
+
+    // Call while the generation runs, cheap once the breeding has started.
+    void update(const std::vector<PlayField*>& fields);
+    // Starts the next generation, breeding now if update() couldn't. With a
+    // fitness per field, the parents are chosen on it : don't call update()
+    // during such generations.
+    void advance(std::vector<PlayField*>& fields, const std::vector<float>* fitness = nullptr);
+
+    // Applies from the next breeding on, one already started keeps its own.
+    void set_mutated_genes(int genes)
+    { m_params.mutated_genes = std::max(genes, 1); }
+    void set_mutation_sigma(double sigma)
+    { m_params.mutation.sigma = sigma; }
+    double mutation_sigma() const
+    { return m_params.mutation.sigma; }
+
+    // generations whose offspring was ready before their end
+    size_t early_count() const
+    { return m_early_count; }
+
+private:
+    void start_breeding(const neural_net& parent_1, const neural_net& parent_2, size_t count);
+
+    ga_params m_params;
+    std::future<std::vector<neural_net>> m_offspring;
+    size_t m_early_count { 0 };
+};
+
+// Stops the rollouts whose score_upper_bound() is below the final score of
+// the parent_count-th best finished field : they can't become parents
+// anymore. Each decision is logged to `log` (if not null) as a csv line
+// generation,field,score,upper_bound,threshold. Returns how many were stopped.
+size_t prune_hopeless(std::vector<PlayField*>& fields, int generation, FILE* log);
+
+#endif // TRAINER_HPP
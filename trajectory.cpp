@@ -0,0 +1,263 @@
+/*
+trajectory.cpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#include "trajectory.hpp"
+
+#include <cmath>
+
+namespace
+{
+
+const uint32_t file_magic    = 0x52544e4e; // "NNTR"
+const uint32_t episode_magic = 0x5350454e; // "NEPS"
+const uint32_t version       = 1;
+
+// fixed-point scale of each channel, in the order of lander_state
+const float scales[trajectory_buffer::channels] = { 64, 64, 4096, 4096, 256, 4096, 4096 };
+
+void put_varint(std::vector<uint8_t>& out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+bool get_varint(const uint8_t*& in, const uint8_t* end, uint32_t& value)
+{
+    value = 0;
+    for (int shift { 0 }; in < end && shift < 35; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+uint32_t zigzag(int32_t value)
+{ return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+int32_t unzigzag(uint32_t value)
+{ return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+struct episode_header
+{
+    uint32_t magic;
+    uint32_t generation;
+    uint32_t agent;
+    float    score;
+    float    time_step;
+    uint32_t ticks;
+    uint32_t payload_size;
+};
+
+}
+
+void trajectory_buffer::push(const lander_state &state)
+{
+    const float values[channels] = { state.x, state.y, state.vx, state.vy, state.angle, state.thrust, state.steer };
+    for (int c { 0 }; c < channels; ++c)
+        m_samples.push_back((int32_t)std::lround(values[c] * scales[c]));
+}
+
+trajectory_recorder::~trajectory_recorder()
+{
+    close();
+}
+
+bool trajectory_recorder::open(const std::string &path)
+{
+    close();
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        perror(path.c_str());
+        return false;
+    }
+
+    const uint32_t header[2] = { file_magic, version };
+    fwrite(header, sizeof(header), 1, m_file);
+
+    m_closing = false;
+    m_writer = std::thread(&trajectory_recorder::writer_loop, this);
+    return true;
+}
+
+void trajectory_recorder::close()
+{
+    if (!m_file)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_wakeup.notify_one();
+    m_writer.join();
+
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void trajectory_recorder::commit(uint32_t generation, uint32_t agent, float score, float time_step, trajectory_buffer &buffer)
+{
+    if (!m_file)
+        return;
+
+    pending episode;
+    episode.info.generation = generation;
+    episode.info.agent      = agent;
+    episode.info.score      = score;
+    episode.info.time_step  = time_step;
+    episode.info.ticks      = buffer.ticks();
+
+    // hand the storage over and give the buffer a fresh one of the same capacity
+    size_t capacity = buffer.samples().capacity();
+    episode.samples.swap(buffer.samples());
+    buffer.samples().reserve(capacity);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.emplace_back(std::move(episode));
+    }
+    m_wakeup.notify_one();
+}
+
+void trajectory_recorder::writer_loop()
+{
+    std::vector<uint8_t> payload;
+
+    while (true)
+    {
+        pending episode;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [this] { return m_closing || !m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            episode = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        payload.clear();
+        int32_t previous[trajectory_buffer::channels] {};
+        int32_t before_previous[trajectory_buffer::channels] {};
+        for (size_t tick { 0 }; tick < episode.info.ticks; ++tick)
+        {
+            for (int c { 0 }; c < trajectory_buffer::channels; ++c)
+            {
+                int32_t value     = episode.samples[tick*trajectory_buffer::channels + c];
+                int32_t predicted = 2*previous[c] - before_previous[c];
+                put_varint(payload, zigzag(value - predicted));
+                before_previous[c] = previous[c];
+                previous[c] = value;
+            }
+        }
+
+        episode_header header { episode_magic, episode.info.generation, episode.info.agent, episode.info.score,
+                    episode.info.time_step, episode.info.ticks, (uint32_t)payload.size() };
+        fwrite(&header, sizeof(header), 1, m_file);
+        fwrite(payload.data(), 1, payload.size(), m_file);
+    }
+}
+
+trajectory_player::~trajectory_player()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+bool trajectory_player::open(const std::string &path)
+{
+    m_file = fopen(path.c_str(), "rb");
+    if (!m_file)
+    {
+        perror(path.c_str());
+        return false;
+    }
+
+    uint32_t header[2];
+    if (fread(header, sizeof(header), 1, m_file) != 1 || header[0] != file_magic || header[1] != version)
+    {
+        fprintf(stderr, "%s: not a trajectory log\n", path.c_str());
+        return false;
+    }
+
+    episode_header episode;
+    while (fread(&episode, sizeof(episode), 1, m_file) == 1 && episode.magic == episode_magic)
+    {
+        episode_info info;
+        info.generation   = episode.generation;
+        info.agent        = episode.agent;
+        info.score        = episode.score;
+        info.time_step    = episode.time_step;
+        info.ticks        = episode.ticks;
+        info.offset       = ftell(m_file);
+        info.payload_size = episode.payload_size;
+        m_episodes.emplace_back(info);
+
+        if (fseek(m_file, episode.payload_size, SEEK_CUR) != 0)
+            break;
+    }
+
+    return true;
+}
+
+bool trajectory_player::load(size_t index, std::vector<lander_state> &states) const
+{
+    const auto& info = m_episodes.at(index);
+
+    std::vector<uint8_t> payload(info.payload_size);
+    if (fseek(m_file, info.offset, SEEK_SET) != 0 || fread(payload.data(), 1, payload.size(), m_file) != payload.size())
+        return false;
+
+    states.resize(info.ticks);
+
+    const uint8_t* in  = payload.data();
+    const uint8_t* end = in + payload.size();
+    int32_t previous[trajectory_buffer::channels] {};
+    int32_t before_previous[trajectory_buffer::channels] {};
+    for (auto& state : states)
+    {
+        float values[trajectory_buffer::channels];
+        for (int c { 0 }; c < trajectory_buffer::channels; ++c)
+        {
+            uint32_t residual;
+            if (!get_varint(in, end, residual))
+                return false;
+            int32_t value = 2*previous[c] - before_previous[c] + unzigzag(residual);
+            before_previous[c] = previous[c];
+            previous[c] = value;
+            values[c] = value / scales[c];
+        }
+        state = { values[0], values[1], values[2], values[3], values[4], values[5], values[6] };
+    }
+
+    return true;
+}
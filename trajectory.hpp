@@ -0,0 +1,128 @@
+/*
+trajectory.hpp
+
+Copyright (c) 19 Yann BOUCHER (yann)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// Per-tick state of a lander, as recorded and replayed.
+struct lander_state
+{
+    float x { 0 }, y { 0 };
+    float vx { 0 }, vy { 0 };
+    float angle  { 0 };
+    float thrust { 0 };
+    float steer  { 0 };
+};
+
+// Hot loop side : appends fixed-point samples to a preallocated buffer,
+// nothing else. Encoding happens later, on the recorder's thread.
+class trajectory_buffer
+{
+public:
+    static const int channels = 7;
+
+    void push(const lander_state& state);
+    void clear()
+    { m_samples.clear(); }
+    size_t ticks() const
+    { return m_samples.size() / channels; }
+
+    std::vector<int32_t>& samples()
+    { return m_samples; }
+
+private:
+    std::vector<int32_t> m_samples;
+};
+
+struct episode_info
+{
+    uint32_t generation { 0 };
+    uint32_t agent      { 0 };
+    float    score      { 0 };
+    float    time_step  { 0 };
+    uint32_t ticks      { 0 };
+    long     offset     { 0 }; // of the payload in the file
+    uint32_t payload_size { 0 };
+};
+
+// Writes episodes to a log : every channel is predicted linearly from the two
+// previous ticks and only the zigzag varint residual is stored, which takes a
+// byte or two per channel for smooth flights instead of four.
+class trajectory_recorder
+{
+public:
+    ~trajectory_recorder();
+
+    bool open(const std::string& path);
+    void close();
+
+    // Takes the buffer's content (leaving it empty) and queues it for encoding.
+    void commit(uint32_t generation, uint32_t agent, float score, float time_step, trajectory_buffer& buffer);
+
+private:
+    struct pending
+    {
+        episode_info info;
+        std::vector<int32_t> samples;
+    };
+
+    void writer_loop();
+
+    FILE* m_file { nullptr };
+    std::thread m_writer;
+    std::mutex  m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<pending> m_queue;
+    bool m_closing { false };
+};
+
+// Random access over a log : the index is built by skipping from header to
+// header, an episode is only decoded when loaded.
+class trajectory_player
+{
+public:
+    ~trajectory_player();
+
+    bool open(const std::string& path);
+
+    const std::vector<episode_info>& episodes() const
+    { return m_episodes; }
+
+    bool load(size_t episode, std::vector<lander_state>& states) const;
+
+private:
+    FILE* m_file { nullptr };
+    std::vector<episode_info> m_episodes;
+};
+
+#endif // TRAJECTORY_HPP